@@ -0,0 +1,25 @@
+#!/bin/bash
+die() { echo "$@" >&2; exit 1
+}
+
+echo 'Testing binary index output (-mi{b|c}, -mm{b|c}) against text'
+
+[ -x ./blant-index2text ] || die "should be run from top-level directory of the BLANT repo, after 'make blant-index2text'"
+set -o pipefail # so that a crash on either side of the conversion fails the test
+fail() { rm -f /tmp/text$$ /tmp/binary$$; die "$@"; }
+
+# Both binary layouts must convert back to exactly the text output of the same run.
+for ARGS in "-k 5 -s MCMC -mi -n 100000 -di" "-k 7 -s NBE -mi -n 10000 -db" "-k 4 -s MCMC -mm -n 1000 -do"; do
+    MODE=`echo "$ARGS" | grep -o -- '-m[im]'`
+    ./blant $ARGS -r 1 networks/syeast.el 2>/dev/null > /tmp/text$$ || fail "blant failed: $ARGS"
+    [ -s /tmp/text$$ ] || fail "blant printed nothing: $ARGS"
+    for FORMAT in b c; do
+	./blant ${ARGS/$MODE/$MODE$FORMAT} -r 1 networks/syeast.el 2>/dev/null | ./blant-index2text > /tmp/binary$$ ||
+	    fail "blant or blant-index2text failed: ${ARGS/$MODE/$MODE$FORMAT}"
+	cmp /tmp/binary$$ /tmp/text$$ || fail "binary index $FORMAT differs from text: $ARGS"
+    done
+done
+rm -f /tmp/text$$ /tmp/binary$$
+
+echo 'Done testing binary index output'
+exit 0
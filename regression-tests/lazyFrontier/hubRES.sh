@@ -0,0 +1,24 @@
+#!/bin/bash
+die() { echo "$@" >&2; exit 1
+}
+
+echo 'Testing that the lazy frontier of -s RES samples the same graphlet concentrations as the exact frontier'
+
+[ -x ./blant ] || die "should be run from top-level directory of the BLANT repo, after 'make blant'"
+fail() { rm -f /tmp/hub$$.el /tmp/lazy$$ /tmp/exact$$; die "$@"; }
+
+# A small fixed graph of mean degree about 8, plus a hub adjacent to every 8th node. Small frontiers make a node
+# that wrongly re-enters the frontier (eg., a member the reservoir evicted) common enough to shift the concentrations.
+awk 'BEGIN{for(a=0;a<80;a++){ if(a%8==0) print "hub", a; for(b=a+1;b<80;b++) if((a*7919+b*104729+a*b*31)%100 < 10) print a, b}}' > /tmp/hub$$.el
+# -s RES1 makes every sample lazy (every node is a "hub"), and -s RES1000000000 makes every sample exact.
+./blant -r 1 -k 5 -n 1000000 -s RES1 -mfd /tmp/hub$$.el 2>/dev/null > /tmp/lazy$$ || fail "blant -s RES1 failed"
+./blant -r 2 -k 5 -n 1000000 -s RES1000000000 -mfd /tmp/hub$$.el 2>/dev/null > /tmp/exact$$ ||
+    fail "blant -s RES1000000000 failed"
+# With a million samples each, the standard error of a difference is below 0.0007 for every graphlet.
+paste /tmp/lazy$$ /tmp/exact$$ | awk 'NF!=4 || $2!=$4{bad=1; exit} {n++; d=$1-$3; if(d<0)d=-d; if(d>max){max=d; g=$2}}
+    END{if(bad || !n) exit 1; printf "largest difference %.4f (graphlet %s) over %d graphlets\n", max, g, n; exit (max > 0.003)}' ||
+    fail "lazy and exact RES concentrations differ, or are missing"
+rm -f /tmp/hub$$.el /tmp/lazy$$ /tmp/exact$$
+
+echo 'Done testing the lazy frontier'
+exit 0
@@ -0,0 +1,21 @@
+#!/bin/bash
+die() { echo "$@" >&2; exit 1
+}
+
+echo 'Testing -s EXACT against ORCA'
+
+TEST_DIR=`pwd`/regression-tests/orcaNumbering
+[ -d "$TEST_DIR" ] || die "should be run from top-level directory of the BLANT repo"
+
+# Unlike sampling, exhaustive enumeration must reproduce ORCA's orbit counts exactly. ORCA's columns are orbits
+# 0 through 72; orbit 0 is the degree, and BLANT with -k 3, 4, 5 gives orbits 1-3, 4-14, and 15-72 respectively.
+for t in 1 2; do
+    ARGS="-s EXACT -mo -t $t $TEST_DIR/5.el"
+    paste -d' ' <(./blant -k 3 $ARGS 2>/dev/null | sort -n | cut -d' ' -f2-) \
+		<(./blant -k 4 $ARGS 2>/dev/null | sort -n | cut -d' ' -f2-) \
+		<(./blant -k 5 $ARGS 2>/dev/null | sort -n | cut -d' ' -f2-) |
+	cmp - <(cut -d' ' -f2- $TEST_DIR/5.orca) || die "-s EXACT -t $t ODV differs from ORCA"
+done
+
+echo 'Done testing -s EXACT'
+exit 0
@@ -0,0 +1,30 @@
+#!/bin/bash
+die() { echo "$@" >&2; exit 1
+}
+
+echo 'Testing the asymptotically correct samplers against -s EXACT graphlet concentrations'
+
+[ -x ./blant ] || die "should be run from top-level directory of the BLANT repo, after 'make blant'"
+fail() { rm -f /tmp/graph$$.el /tmp/exact$$ /tmp/sampled$$; die "$@"; }
+
+# A small fixed connected graph (80 nodes of mean degree about 8, and a hub adjacent to every 8th of them), so that
+# EXACT is instant and a million samples pin every concentration down well. A walk can't leave its connected
+# component, so the graph must be connected for MHS and OOZE to agree with EXACT.
+awk 'BEGIN{for(a=0;a<80;a++){ if(a%8==0) print "hub", a; for(b=a+1;b<80;b++) if((a*7919+b*104729+a*b*31)%100 < 10) print a, b}}' > /tmp/graph$$.el
+for k in 4 5; do
+    ./blant -k $k -s EXACT -mfd /tmp/graph$$.el 2>/dev/null > /tmp/exact$$ || fail "blant -k $k -s EXACT failed"
+    for METHOD in CC MHS OOZE; do
+	./blant -r 1 -k $k -n 1000000 -s $METHOD -mfd /tmp/graph$$.el 2>/dev/null > /tmp/sampled$$ ||
+	    fail "blant -k $k -s $METHOD failed"
+	# Over several seeds the largest difference stays below 0.006 for CC and 0.003 for MHS and OOZE; NBE, EBE and
+	# RES are off by 0.017 or more.
+	paste /tmp/sampled$$ /tmp/exact$$ | awk 'NF!=4 || $2!=$4{bad=1; exit} {n++; d=$1-$3; if(d<0)d=-d; if(d>max){max=d; g=$2}}
+	    END{if(bad || !n) exit 1; printf "-k '$k' -s '$METHOD': largest difference %.4f (graphlet %s) over %d graphlets\n", max, g, n
+		exit (max > 0.01)}' ||
+	    fail "-k $k -s $METHOD concentrations differ from EXACT, or are missing"
+    done
+done
+rm -f /tmp/graph$$.el /tmp/exact$$ /tmp/sampled$$
+
+echo 'Done testing samplers against -s EXACT'
+exit 0
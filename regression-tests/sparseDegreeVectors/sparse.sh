@@ -0,0 +1,26 @@
+#!/bin/bash
+die() { echo "$@" >&2; exit 1
+}
+
+echo 'Testing sparse ODV/GDV output (-mos, -mgs) against the full vectors'
+
+[ -x ./blant ] || die "should be run from top-level directory of the BLANT repo, after 'make blant'"
+fail() { rm -f /tmp/sparse$$ /tmp/full$$; die "$@"; }
+
+# Filling in the zeros of each sparse line must give exactly the full line of the same run. k=7 stores its counts
+# sparsely too, and -t 2 has the children send sparse lines to the parent.
+for ARGS in "-k 4 -s NBE -mo -n 100000" "-k 7 -s NBE -mo -n 100000" "-k 7 -s MCMC -mg -n 100000 -t 2"; do
+    MODE=`echo "$ARGS" | grep -o -- '-m[og]'`
+    ./blant ${ARGS/$MODE/${MODE}s} -r 1 networks/syeast.el 2>/dev/null > /tmp/sparse$$ ||
+	fail "blant failed: ${ARGS/$MODE/${MODE}s}"
+    ./blant $ARGS -r 1 networks/syeast.el 2>/dev/null > /tmp/full$$ || fail "blant failed: $ARGS"
+    COLUMNS=`head -1 /tmp/full$$ | awk '{print NF-1}'`
+    [[ "$COLUMNS" =~ ^[1-9][0-9]*$ ]] || fail "no degree vector columns in the full output: $ARGS"
+    awk '{printf "%s", $1; delete c; for(i=2;i<=NF;i++){split($i,f,":"); c[f[1]]=f[2]}
+	for(i=0;i<'$COLUMNS';i++) printf " %s", (i in c) ? c[i] : 0; print ""}' /tmp/sparse$$ |
+	cmp - /tmp/full$$ || fail "sparse output differs from the full output: $ARGS"
+done
+rm -f /tmp/sparse$$ /tmp/full$$
+
+echo 'Done testing sparse ODV/GDV output'
+exit 0
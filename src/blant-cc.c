@@ -0,0 +1,158 @@
+#include <math.h>
+#include "blant.h"
+#include "blant-cc.h"
+#include "blant-utils.h"
+
+/*
+** -s CC: color coding (Alon, Yuster & Zwick 1995), used for sampling as in Bressan, Leucci & Panconesi's Motivo (2019).
+** Give each node one of k colors at random; a k-graphlet is "colorful" if its nodes all have different colors, which
+** happens with probability k!/k^k regardless of its shape. A dynamic program counts, for every node v and color set
+** C containing v's color, the colorful trees T(v,C) rooted at v that use exactly the colors C. Every such tree with
+** more than one node splits uniquely into the subtree of the child u of v whose subtree holds the lowest color of
+** C - color(v), and the rest, which is again a tree rooted at v:
+**	T(v,C) = sum_{C1} N(v,C1) * T(v, C-C1),   where N(v,C1) = sum_{u adjacent to v} T(u,C1)
+** and C1 ranges over the subsets of C - color(v) that contain its lowest color. Walking this recursion backwards
+** with probabilities proportional to the terms samples a colorful k-tree uniformly at random, and the k nodes it
+** spans induce a graphlet. That graphlet is sampled in proportion to its number of spanning trees sigma (computed
+** once per canonical with Kirchhoff's theorem), so weighting each sample by trees/sigma gives unbiased graphlet
+** counts, and the usual MCMC machinery turns the weights into concentrations. Unlike a random walk, rare dense
+** graphlets are *over*-sampled, since they have the most spanning trees.
+**
+** Each coloring is used for CC_SAMPLES_PER_COLORING samples and then replaced, so that colorings are independent
+** batches whose spread gives an error estimate that includes the variance due to the coloring itself.
+*/
+
+static double *_ccT, *_ccN; // T(v,C) and N(v,C) as above, at [(v << k) | C]
+static double *_ccRootCumulative; // running sum over v of T(v, all colors), to pick the root
+static double _ccTrees; // colorful k-trees in the current coloring
+static double _ccSpanningTrees[MAX_CANONICALS];
+static unsigned char *_ccColor;
+static int _ccSamplesLeft; // until the next recoloring
+
+// Number of spanning trees of canonical graphlet canon: the determinant of its Laplacian with one row and column removed.
+static double CcSpanningTrees(int canon, int k)
+{
+    double L[MAX_K][MAX_K], det = 1;
+    int i, j, r;
+    TINY_GRAPH *g = TinyGraphAlloc(k);
+    Int2TinyGraph(g, _canonList[canon]);
+    for(i=1; i<k; i++) for(j=1; j<k; j++)
+	L[i][j] = (i == j) ? g->degree[i] : -(double)!!TinyGraphAreConnected(g, i, j);
+    TinyGraphFree(g);
+    for(i=1; i<k; i++) { // Gaussian elimination with partial pivoting
+	int pivot = i;
+	for(r=i+1; r<k; r++) if(fabs(L[r][i]) > fabs(L[pivot][i])) pivot = r;
+	if(L[pivot][i] == 0) return 0;
+	if(pivot != i) { for(j=1; j<k; j++) { double t = L[i][j]; L[i][j] = L[pivot][j]; L[pivot][j] = t; } det = -det; }
+	det *= L[i][i];
+	for(r=i+1; r<k; r++) {
+	    double f = L[r][i] / L[i][i];
+	    for(j=i; j<k; j++) L[r][j] -= f * L[i][j];
+	}
+    }
+    return floor(det + 0.5);
+}
+
+static void CcRecolor(GRAPH *G, int k)
+{
+    int v, s, C, tries = 0;
+    unsigned all = (1U << k) - 1;
+    do {
+	if(++tries > CC_MAX_RECOLORINGS)
+	    Fatal("-s CC: no colorful %d-trees found in %d random colorings; is the graph too small?", k, CC_MAX_RECOLORINGS);
+	for(v=0; v<G->n; v++) _ccColor[v] = k * RandomUniform();
+	for(s=1; s<=k; s++) {
+	    for(v=0; v<G->n; v++) {
+		double *T = _ccT + ((long)v << k), *N = _ccN + ((long)v << k);
+		unsigned mine = 1U << _ccColor[v];
+		for(C=0; C<=all; C++) if(__builtin_popcount(C) == s) {
+		    if(!(C & mine)) { T[C] = 0; continue; }
+		    if(s == 1) { T[C] = 1; continue; }
+		    unsigned rest = C & ~mine, lowest = rest & -rest, others = rest & ~lowest, sub = 0;
+		    double sum = 0;
+		    do { // every subset sub of others
+			sum += N[lowest | sub] * T[C & ~(lowest | sub)];
+			sub = (sub - others) & others;
+		    } while(sub);
+		    T[C] = sum;
+		}
+	    }
+	    if(s < k) for(v=0; v<G->n; v++) {
+		double *N = _ccN + ((long)v << k);
+		int j;
+		for(C=0; C<=all; C++) if(__builtin_popcount(C) == s) {
+		    double sum = 0;
+		    for(j=0; j<G->degree[v]; j++) sum += _ccT[((long)G->neighbor[v][j] << k) | C];
+		    N[C] = sum;
+		}
+	    }
+	}
+	double cumulative = 0;
+	for(v=0; v<G->n; v++) _ccRootCumulative[v] = (cumulative += _ccT[((long)v << k) | all]);
+	_ccTrees = cumulative / k; // each tree was counted once per node it can be rooted at
+    } while(_ccTrees == 0);
+}
+
+// Add to V/Varray the nodes of a random colorful tree rooted at v with colors C, in proportion to T(v,C).
+static void CcSampleTree(GRAPH *G, int k, int v, unsigned C, SET *V, int *Varray, int *size)
+{
+    while(C != (1U << _ccColor[v])) {
+	double *T = _ccT + ((long)v << k), *N = _ccN + ((long)v << k);
+	unsigned rest = C & ~(1U << _ccColor[v]), lowest = rest & -rest, others = rest & ~lowest, sub = 0, C1 = 0;
+	double r = RandomUniform() * T[C];
+	do { // pick C1, the colors of the child subtree holding the lowest color
+	    if(N[lowest | sub] * T[C & ~(lowest | sub)] > 0) C1 = lowest | sub; // roundoff can leave r just past the end
+	    if((r -= N[lowest | sub] * T[C & ~(lowest | sub)]) < 0) break;
+	    sub = (sub - others) & others;
+	} while(sub);
+	assert(C1);
+	int j, u = -1;
+	r = RandomUniform() * N[C1];
+	for(j=0; j<G->degree[v]; j++) { // then that child
+	    double t = _ccT[((long)G->neighbor[v][j] << k) | C1];
+	    if(t > 0) u = G->neighbor[v][j];
+	    if((r -= t) < 0) break;
+	}
+	assert(u >= 0);
+	CcSampleTree(G, k, u, C1, V, Varray, size);
+	C &= ~C1; // and continue with the rest of v's tree
+    }
+    SetAdd(V, v);
+    Varray[(*size)++] = v;
+}
+
+// Sample a graphlet as the node set of a uniformly random colorful k-tree; returns its weight (see above).
+double SampleGraphletColorCoding(SET *V, int *Varray, GRAPH *G, int k)
+{
+    static TINY_GRAPH *g;
+    int lo = 0, hi = G->n - 1, size = 0;
+    if(!_ccT) {
+	int canon;
+	_ccT = Malloc((G->n * sizeof(double)) << k);
+	_ccN = Malloc((G->n * sizeof(double)) << k);
+	_ccRootCumulative = Malloc(G->n * sizeof(double));
+	_ccColor = Malloc(G->n);
+	g = TinyGraphAlloc(k);
+	for(canon=0; canon<_numCanon; canon++) if(SetIn(_connectedCanonicals, canon))
+	    _ccSpanningTrees[canon] = CcSpanningTrees(canon, k);
+    }
+    if(_ccSamplesLeft-- == 0) {
+	CcRecolor(G, k);
+	_ccSamplesLeft = CC_SAMPLES_PER_COLORING - 1;
+    }
+    double r = RandomUniform() * _ccRootCumulative[G->n - 1];
+    while(lo < hi) { // binary search for the root
+	int mid = (lo + hi) / 2;
+	if(_ccRootCumulative[mid] > r) hi = mid; else lo = mid + 1;
+    }
+    SetEmpty(V);
+    CcSampleTree(G, k, lo, (1U << k) - 1, V, Varray, &size);
+    assert(size == k);
+
+    TinyGraphInducedFromGraph(g, G, Varray);
+    int GintOrdinal = _K[TinyGraph2Int(g, k)];
+    assert(_ccSpanningTrees[GintOrdinal] > 0);
+    double weight = _ccTrees / _ccSpanningTrees[GintOrdinal];
+    _graphletConcentration[GintOrdinal] += weight;
+    return weight;
+}
@@ -0,0 +1,12 @@
+#ifndef BLANT_CC_H
+#define BLANT_CC_H
+#include "blant.h"
+
+// -s CC (color coding): samples per random coloring of the nodes. Each coloring is also one batch for the error
+// estimate (see ConfidenceAddBatch in blant.c), and one job with -t; it must be a multiple of SAMPLE_BATCH.
+#define CC_SAMPLES_PER_COLORING (1 << 14)
+#define CC_MAX_RECOLORINGS 100 // in a row, before giving up on finding a colorful k-tree
+
+double SampleGraphletColorCoding(SET *V, int *Varray, GRAPH *G, int k);
+
+#endif
@@ -0,0 +1,60 @@
+#include <unistd.h>
+#include "blant.h"
+#include "blant-dedup.h"
+
+int _dedupMegabytes = DEDUP_DEFAULT_MEGABYTES;
+
+typedef struct _dedupBucket {
+    unsigned long fingerprint[DEDUP_WAYS]; // 0 means an empty slot
+    unsigned char referenced, hand; // bit i is set iff fingerprint[i] was seen again since it went in; the clock hand
+} DEDUP_BUCKET;
+static DEDUP_BUCKET *_dedupTable; // aligned to cache lines
+static unsigned long _dedupBuckets;
+static long _dedupLookups, _dedupHits, _dedupEvictions;
+
+static void DedupInit(void)
+{
+    assert(sizeof(DEDUP_BUCKET) == 64);
+    _dedupBuckets = ((unsigned long)_dedupMegabytes << 20) / sizeof(DEDUP_BUCKET) - 1;
+    assert(_dedupBuckets >= 1 && _dedupBuckets < (1UL << 32));
+    char *memory = Calloc(_dedupBuckets + 1, sizeof(DEDUP_BUCKET)); // never freed
+    _dedupTable = (DEDUP_BUCKET*)(memory + (-(unsigned long)memory & (sizeof(DEDUP_BUCKET) - 1)));
+}
+
+Boolean DedupSeen(unsigned long fingerprint)
+{
+    int i;
+    if(!_dedupTable) DedupInit();
+    if(!fingerprint) fingerprint = 1;
+    unsigned long b = ((fingerprint >> 32) * _dedupBuckets) >> 32; // the top 32 bits, scaled to [0,_dedupBuckets)
+    DEDUP_BUCKET *bucket = _dedupTable + b;
+    unsigned long *slot = bucket->fingerprint;
+    ++_dedupLookups;
+    for(i=0; i<DEDUP_WAYS; i++) {
+	if(slot[i] == fingerprint) {
+	    ++_dedupHits;
+	    bucket->referenced |= 1 << i;
+	    return true;
+	}
+	if(!slot[i]) { // slots fill up in order and are never emptied, so fingerprint isn't further along
+	    slot[i] = fingerprint;
+	    return false;
+	}
+    }
+    // The bucket is full: advance the hand past the referenced entries, giving each a second chance, to the victim.
+    while(bucket->referenced & (1 << bucket->hand)) {
+	bucket->referenced &= ~(1 << bucket->hand);
+	bucket->hand = (bucket->hand + 1) % DEDUP_WAYS;
+    }
+    slot[bucket->hand] = fingerprint;
+    bucket->hand = (bucket->hand + 1) % DEDUP_WAYS;
+    ++_dedupEvictions;
+    return false;
+}
+
+void DedupReport(void)
+{
+    if(!_dedupLookups) return;
+    Note("duplicate filter (process %d, %d MB): %ld of %ld node sets were duplicates (%.2f%%); %ld evicted",
+	getpid(), _dedupMegabytes, _dedupHits, _dedupLookups, 100.0*_dedupHits/_dedupLookups, _dedupEvictions);
+}
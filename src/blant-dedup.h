@@ -0,0 +1,17 @@
+#ifndef BLANT_DEDUP_H
+#define BLANT_DEDUP_H
+#include "blant.h"
+
+// The filter behind NodeSetSeenRecently (blant-output.c), which drops index entries whose node set was output recently.
+// It remembers 64-bit fingerprints of node sets in a hash table of DEDUP_WAYS-entry buckets, one cache line each (with
+// their bookkeeping). When a bucket is full a "clock" picks the entry to evict, sparing those seen again since they
+// went in.
+// Each process (so each -t job) has its own table of _dedupMegabytes, set with -D; -D 0 turns the filter off.
+#define DEDUP_DEFAULT_MEGABYTES 64
+#define DEDUP_WAYS 7
+extern int _dedupMegabytes;
+
+Boolean DedupSeen(unsigned long fingerprint); // whether fingerprint is in the table; if not, it is now
+void DedupReport(void); // Note the hit rate on stderr, if the filter was used at all
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef BLANT_INDEX_FORMAT_H
+#define BLANT_INDEX_FORMAT_H
+#include <stdio.h>
+#include "misc.h"
+
+/*
+** Binary index output (-mi{b|c}, -mm{b|c}): the same lines as -mi (or -mm), as fixed-width records rather than text.
+** It's a stream, so it can be piped; everything is little-endian and nothing is padded:
+**
+**   header:  the 8 characters BLANT_INDEX_MAGIC
+**            uint32 k; uint32 layout (BLANT_INDEX_ROWS or BLANT_INDEX_COLUMNS); uint8 display mode (the -d letter)
+**            uint64 numSamples (the -n it was run with)
+**            uint32 numCanon, then for each canonical ordinal: uint8 length, then its ID as the text output shows it
+**            uint32 numNames, then for each node: uint16 length, then its name; numNames is 0 if nodes are integers
+**   blocks:  uint32 count, then count records, either one by one (uint16 ordinal, then k x uint32 node) with
+**            BLANT_INDEX_ROWS, or column by column (count x uint16 ordinal, then k times count x uint32 node) with
+**            BLANT_INDEX_COLUMNS. Nodes are in canonical order, as in the text. A count of 0 ends the blocks.
+**   trailer: uint64 the total number of records
+**
+** The reader declared below (in blant-index-reader.c) needs nothing of BLANT but libwayne, for use by other programs;
+** see blant-index2text.c, which converts back to the text format.
+*/
+#define BLANT_INDEX_MAGIC "BLANTIX1"
+#define BLANT_INDEX_ROWS 1
+#define BLANT_INDEX_COLUMNS 2
+#define BLANT_INDEX_BLOCK 4096 // records per block written by BLANT; readers must accept any count
+#define BLANT_INDEX_MAX_K 8
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _blantIndexReader {
+    FILE *fp;
+    int k, layout;
+    char displayMode;
+    unsigned long numSamples, records; // records read so far
+    int numCanon, numNames;
+    char **canon, **name; // canonical IDs and node names (NULL if there are no names) as the text output shows them
+    unsigned blockSpace; // records the arrays below have room for
+    unsigned short *ordinal;
+    unsigned *column[BLANT_INDEX_MAX_K]; // column[j][i] is node j of record i in the current block
+    char *raw; // a whole block as read, with BLANT_INDEX_ROWS
+} BLANT_INDEX_READER;
+
+BLANT_INDEX_READER *BlantIndexOpen(FILE *fp); // reads the header; Fatal if fp is not a binary index
+// Read the next block: returns the number of records in it, with *ordinal and column[0..k-1] pointing at its columns
+// (which are only valid until the next call); 0 at the end.
+unsigned BlantIndexNextBlock(BLANT_INDEX_READER *r, const unsigned short **ordinal, const unsigned *column[]);
+void BlantIndexClose(BLANT_INDEX_READER *r); // frees r but does not fclose its FILE
+
+#ifdef __cplusplus
+}
+#endif
+#endif
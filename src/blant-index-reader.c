@@ -0,0 +1,107 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "blant-index-format.h"
+
+// Reader for BLANT's binary index format; see blant-index-format.h for the layout. Like the writer, we assume a
+// little-endian machine, and check it.
+
+static void ReadExactly(BLANT_INDEX_READER *r, void *buf, size_t bytes, const char *what)
+{
+    if(bytes && fread(buf, 1, bytes, r->fp) != bytes)
+	Fatal("binary index: unexpected end of file reading %s (after %lu records)", what, r->records);
+}
+
+static unsigned long ReadUnsigned(BLANT_INDEX_READER *r, int bytes, const char *what)
+{
+    uint64_t value = 0;
+    ReadExactly(r, &value, bytes, what); // the low-order bytes, on a little-endian machine
+    return value;
+}
+
+static char *ReadString(BLANT_INDEX_READER *r, int lengthBytes, const char *what)
+{
+    unsigned long length = ReadUnsigned(r, lengthBytes, what);
+    char *s = Malloc(length + 1);
+    ReadExactly(r, s, length, what);
+    s[length] = '\0';
+    return s;
+}
+
+BLANT_INDEX_READER *BlantIndexOpen(FILE *fp)
+{
+    unsigned one = 1;
+    char magic[sizeof(BLANT_INDEX_MAGIC)-1];
+    int i;
+    if(*(char*)&one != 1) Fatal("BlantIndexOpen: the binary index format is little-endian, and this machine isn't");
+    BLANT_INDEX_READER *r = Calloc(1, sizeof(BLANT_INDEX_READER));
+    r->fp = fp;
+    ReadExactly(r, magic, sizeof(magic), "the header");
+    if(memcmp(magic, BLANT_INDEX_MAGIC, sizeof(magic)) != 0)
+	Fatal("BlantIndexOpen: not a binary BLANT index (expected it to start with %s)", BLANT_INDEX_MAGIC);
+    r->k = ReadUnsigned(r, 4, "k");
+    r->layout = ReadUnsigned(r, 4, "the layout");
+    r->displayMode = ReadUnsigned(r, 1, "the display mode");
+    r->numSamples = ReadUnsigned(r, 8, "the number of samples");
+    if(r->k < 3 || r->k > BLANT_INDEX_MAX_K) Fatal("BlantIndexOpen: k=%d is out of range", r->k);
+    if(r->layout != BLANT_INDEX_ROWS && r->layout != BLANT_INDEX_COLUMNS)
+	Fatal("BlantIndexOpen: unknown layout %d", r->layout);
+    r->numCanon = ReadUnsigned(r, 4, "the number of canonicals");
+    r->canon = Malloc(r->numCanon * sizeof(char*));
+    for(i=0; i<r->numCanon; i++) r->canon[i] = ReadString(r, 1, "the canonical IDs");
+    r->numNames = ReadUnsigned(r, 4, "the number of node names");
+    if(r->numNames) {
+	r->name = Malloc(r->numNames * sizeof(char*));
+	for(i=0; i<r->numNames; i++) r->name[i] = ReadString(r, 2, "the node names");
+    }
+    return r;
+}
+
+unsigned BlantIndexNextBlock(BLANT_INDEX_READER *r, const unsigned short **ordinal, const unsigned *column[])
+{
+    int k = r->k, j;
+    unsigned i, count = ReadUnsigned(r, 4, "a block header");
+    if(count == 0) {
+	unsigned long total = ReadUnsigned(r, 8, "the trailer");
+	if(total != r->records)
+	    Fatal("binary index: the trailer says %lu records, but we read %lu; is the file corrupt?", total, r->records);
+	return 0;
+    }
+    if(count > r->blockSpace) {
+	r->blockSpace = count;
+	r->ordinal = Realloc(r->ordinal, count * sizeof(*r->ordinal));
+	for(j=0; j<k; j++) r->column[j] = Realloc(r->column[j], count * sizeof(unsigned));
+	if(r->layout == BLANT_INDEX_ROWS) r->raw = Realloc(r->raw, count * (2 + 4*k));
+    }
+    if(r->layout == BLANT_INDEX_COLUMNS) {
+	ReadExactly(r, r->ordinal, count * sizeof(*r->ordinal), "a block");
+	for(j=0; j<k; j++) ReadExactly(r, r->column[j], count * sizeof(unsigned), "a block");
+    }
+    else {
+	ReadExactly(r, r->raw, count * (2 + 4*k), "a block");
+	for(i=0; i<count; i++) { // records aren't aligned, so memcpy each field out
+	    char *record = r->raw + i * (2 + 4*k);
+	    memcpy(r->ordinal + i, record, 2);
+	    for(j=0; j<k; j++) memcpy(r->column[j] + i, record + 2 + 4*j, 4);
+	}
+    }
+    for(i=0; i<count; i++) if(r->ordinal[i] >= r->numCanon)
+	Fatal("binary index: record %lu has canonical ordinal %d, but there are only %d", r->records+i, r->ordinal[i], r->numCanon);
+    r->records += count;
+    *ordinal = r->ordinal;
+    for(j=0; j<k; j++) column[j] = r->column[j];
+    return count;
+}
+
+void BlantIndexClose(BLANT_INDEX_READER *r)
+{
+    int i;
+    for(i=0; i<r->numCanon; i++) Free(r->canon[i]);
+    Free(r->canon);
+    for(i=0; i<r->numNames; i++) Free(r->name[i]);
+    if(r->name) Free(r->name);
+    if(r->ordinal) Free(r->ordinal);
+    for(i=0; i<r->k; i++) if(r->column[i]) Free(r->column[i]);
+    if(r->raw) Free(r->raw);
+    Free(r);
+}
@@ -0,0 +1,36 @@
+// Convert BLANT's binary index output (-mi{b|c} or -mm{b|c}) back to the text that -mi (or -mm) would have printed,
+// byte for byte:
+//
+//	./blant -k 7 -n 1000000 -s MCMC -mib -di networks/syeast.el | ./blant-index2text > syeast.index7.txt
+//
+// It doubles as an example of the reader API in blant-index-format.h.
+
+#include <stdio.h>
+#include <string.h>
+#include "misc.h"
+#include "blant-index-format.h"
+
+int main(int argc, char *argv[])
+{
+    FILE *fp = stdin;
+    if(argc > 2) Fatal("USAGE: %s [binaryIndexFile] (default stdin)", argv[0]);
+    if(argc == 2 && !(fp = fopen(argv[1], "r"))) Fatal("cannot open binary index file \"%s\"", argv[1]);
+    BLANT_INDEX_READER *r = BlantIndexOpen(fp);
+    const unsigned short *ordinal;
+    const unsigned *column[BLANT_INDEX_MAX_K];
+    unsigned i, count;
+    int j;
+    while((count = BlantIndexNextBlock(r, &ordinal, column)) > 0) for(i=0; i<count; i++) {
+	fputs(r->canon[ordinal[i]], stdout);
+	for(j=0; j<r->k; j++) {
+	    unsigned v = column[j][i];
+	    if(!r->numNames) printf(" %u", v);
+	    else if(v < r->numNames) { putchar(' '); fputs(r->name[v], stdout); }
+	    else Fatal("record %lu has node %u, but there are only %d node names", r->records - count + i, v, r->numNames);
+	}
+	putchar('\n');
+    }
+    BlantIndexClose(r);
+    if(fp != stdin) fclose(fp);
+    return 0;
+}
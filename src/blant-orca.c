@@ -0,0 +1,338 @@
+#include <assert.h>
+#include "blant.h"
+#include "blant-orca.h"
+
+/*
+** Exact orbit degrees for k=3..5 in the spirit of ORCA (Hocevar & Demsar, Bioinformatics 2014): rather than enumerate
+** every k-graphlet, we enumerate only the connected (k-1)-graphlets S (with -s EXACT's ESU), and count the ways to add
+** a k'th node w combinatorially. For a set T of nodes in S, the number of w outside S adjacent to (at least) all of T
+** is just a degree if |T|=1, and otherwise a scan of the neighbors of T's lowest-degree node.
+**
+** For each orbit o we fix one way to build its graphlet H: a node v whose removal leaves H connected, so that S=H-v
+** is a (k-1)-graphlet in which o's node x sits at canonical position p, and v attaches to canonical positions M.
+** Summed over every S containing x (and every isomorphism of S taking x to p), the number of w adjacent to M is f_o(x).
+** Each k-graphlet around x that contains H (with x in orbit o) as a spanning subgraph adds to it, so
+**	f_o(x) = sum_o' A[o][o'] * ODV(x,o'),
+** where A[o][o] > 0, and A[o][o'] is otherwise nonzero only if o' is an orbit of a graphlet with more edges than H.
+** So the system is triangular, and we solve it for each node from the densest graphlets down. ORCA writes its
+** equations out by hand; here A is computed at start-up by applying the same counting to every k-graphlet, which
+** makes the equations correct by construction for any of BLANT's orbit numberings.
+*/
+
+#define ORCA_MAX_M 4 // S has k-1 <= 4 nodes
+#define ORCA_MAX_KEYS (1 << 6) // labeled graphs on 4 nodes, with one bit per pair of nodes
+#define ORCA_MAX_TYPES 6 // connected graphs on 4 nodes, up to isomorphism
+#define ORCA_MAX_PERMS 24
+#define ORCA_MAX_TERMS 128 // for one position of one S: orbits of S's one-node extensions, times S's automorphisms
+#define ORCA_MAX_ORBITS 128
+
+typedef struct { int orbit, mult; unsigned char mask; } ORCA_TERM; // add mult * (# of w adjacent to mask) to orbit
+
+static int _orcaK, _orcaM, _orcaNumPerms, _orcaNumTypes;
+static char _orcaPerm[ORCA_MAX_PERMS][ORCA_MAX_M];
+static int _orcaPairBit[ORCA_MAX_M][ORCA_MAX_M];
+static struct { // every labeled graph on m nodes, indexed by its key (one bit per pair)
+    int type; // its isomorphism class among the connected ones; -1 if it's disconnected
+    char pos[ORCA_MAX_M]; // the canonical position of each of its nodes
+    unsigned char actual[1 << ORCA_MAX_M]; // a set of canonical positions -> the set of its nodes at them
+} _orcaLocal[ORCA_MAX_KEYS];
+static int _orcaTypeKey[ORCA_MAX_TYPES]; // the key of each type's canonical labeling
+static ORCA_TERM _orcaTerm[ORCA_MAX_TYPES][ORCA_MAX_M][ORCA_MAX_TERMS];
+static int _orcaNumTerms[ORCA_MAX_TYPES][ORCA_MAX_M];
+
+// The equations: orbits in the order they're solved, and each one's nonzero coefficients
+static int _orcaNumSolve, _orcaOrder[ORCA_MAX_ORBITS];
+static long _orcaDiag[ORCA_MAX_ORBITS];
+static int _orcaNumOff[ORCA_MAX_ORBITS], _orcaOffOrbit[ORCA_MAX_ORBITS][ORCA_MAX_ORBITS];
+static long _orcaOffCoef[ORCA_MAX_ORBITS][ORCA_MAX_ORBITS];
+
+Boolean OrcaEquationsApply(int k)
+{
+    return USE_ORCA_EQUATIONS && _outputMode == outputODV && 3 <= k && k <= 5;
+}
+
+// Key of the subgraph of adj (adjacency bitmasks) induced on node[0..m-1], in that order.
+static int OrcaKey(const unsigned adj[], const int node[], int m)
+{
+    int i, j, key = 0;
+    for(i=0; i<m; i++) for(j=i+1; j<m; j++)
+	if(adj[node[i]] & (1U << node[j])) key |= 1 << _orcaPairBit[i][j];
+    return key;
+}
+
+// Key of the graph with the given key once node i is relabeled perm[i].
+static int OrcaPermuteKey(int key, const char perm[])
+{
+    int i, j, result = 0;
+    for(i=0; i<_orcaM; i++) for(j=i+1; j<_orcaM; j++)
+	if(key & (1 << _orcaPairBit[i][j])) result |= 1 << _orcaPairBit[(int)perm[i]][(int)perm[j]];
+    return result;
+}
+
+static unsigned OrcaPermuteMask(unsigned mask, const char perm[])
+{
+    int i;
+    unsigned result = 0;
+    for(i=0; i<_orcaM; i++) if(mask & (1U << i)) result |= 1U << perm[i];
+    return result;
+}
+
+// Whether the nodes in the bitmask "nodes" induce a connected subgraph of adj.
+static Boolean OrcaConnected(const unsigned adj[], unsigned nodes)
+{
+    unsigned reached = nodes & -nodes, prev = 0;
+    int i;
+    while(reached != prev) {
+	prev = reached;
+	for(i=0; i<MAX_K; i++) if(prev & (1U << i)) reached |= adj[i] & nodes;
+    }
+    return reached == nodes;
+}
+
+static void OrcaAddTerm(int type, int q, int orbit, unsigned mask)
+{
+    int i, n = _orcaNumTerms[type][q];
+    for(i=0; i<n; i++) if(_orcaTerm[type][q][i].orbit == orbit && _orcaTerm[type][q][i].mask == mask) {
+	_orcaTerm[type][q][i].mult++;
+	return;
+    }
+    assert(n < ORCA_MAX_TERMS);
+    _orcaTerm[type][q][n].orbit = orbit;
+    _orcaTerm[type][q][n].mask = mask;
+    _orcaTerm[type][q][n].mult = 1;
+    _orcaNumTerms[type][q]++;
+}
+
+// Canonical k-graphlet c as adjacency bitmasks; returns its number of edges.
+static int OrcaCanonAdjacency(TINY_GRAPH *g, int c, unsigned adj[])
+{
+    int i, edges = 0;
+    Int2TinyGraph(g, _canonList[c]);
+    for(i=0; i<_orcaK; i++) { adj[i] = g->A[i]; edges += g->degree[i]; }
+    return edges / 2;
+}
+
+// Splits H (adjacency adj) into S=H-v and v: fills in S's nodes (ascending) and returns S's key, and the set of
+// S's nodes (as indices into S) adjacent to v in *attach.
+static int OrcaSplit(const unsigned adj[], int v, int S[], unsigned *attach)
+{
+    int i, m = 0;
+    *attach = 0;
+    for(i=0; i<_orcaK; i++) if(i != v) {
+	if(adj[v] & (1U << i)) *attach |= 1U << m;
+	S[m++] = i;
+    }
+    return OrcaKey(adj, S, m);
+}
+
+static int OrcaIndexOf(const int S[], int x)
+{
+    int i;
+    for(i=0; i<_orcaM; i++) if(S[i] == x) return i;
+    assert(false);
+    return -1;
+}
+
+void OrcaInit(int k)
+{
+    int m = k-1, i, j, p, key, t, o, o2, v, numKeys, S[ORCA_MAX_M];
+    unsigned all = (1U << m) - 1, adj[MAX_K], attach;
+    assert(3 <= k && k <= 5 && k == _k);
+    if(_orcaK == k) return;
+    _orcaK = k; _orcaM = m;
+    assert(_numOrbits <= ORCA_MAX_ORBITS);
+
+    for(i=0, p=0; i<m; i++) for(j=i+1; j<m; j++) _orcaPairBit[i][j] = _orcaPairBit[j][i] = p++;
+    numKeys = 1 << p;
+    _orcaNumPerms = 0;
+    for(p=0; p < (1 << (2*m)); p++) { // every m-tuple of 2-bit digits that's a permutation of 0..m-1
+	unsigned used = 0;
+	for(i=0; i<m; i++) used |= 1U << ((p >> 2*i) & 3);
+	if(used != all) continue;
+	for(i=0; i<m; i++) _orcaPerm[_orcaNumPerms][i] = (p >> 2*i) & 3;
+	_orcaNumPerms++;
+    }
+
+    // Canonicalize every labeled (k-1)-node graph. Our canonical labeling (the least key) needn't be BLANT's: S's
+    // type is only ever used to look up its terms, which are built in the same labeling.
+    _orcaNumTypes = 0;
+    for(key=0; key<numKeys; key++) {
+	int best = -1, bestKey = -1;
+	for(i=0; i<m; i++) adj[i] = 0;
+	for(i=0; i<m; i++) for(j=i+1; j<m; j++) if(key & (1 << _orcaPairBit[i][j])) { adj[i] |= 1U << j; adj[j] |= 1U << i; }
+	if(!OrcaConnected(adj, all)) { _orcaLocal[key].type = -1; continue; }
+	for(p=0; p<_orcaNumPerms; p++) {
+	    int permuted = OrcaPermuteKey(key, _orcaPerm[p]);
+	    if(best < 0 || permuted < bestKey) { best = p; bestKey = permuted; }
+	}
+	for(t=0; t<_orcaNumTypes && _orcaTypeKey[t] != bestKey; t++) ;
+	if(t == _orcaNumTypes) { assert(t < ORCA_MAX_TYPES); _orcaTypeKey[_orcaNumTypes++] = bestKey; }
+	_orcaLocal[key].type = t;
+	for(i=0; i<m; i++) _orcaLocal[key].pos[i] = _orcaPerm[best][i];
+	for(p=0; p<=all; p++) {
+	    _orcaLocal[key].actual[p] = 0;
+	    for(i=0; i<m; i++) if(p & (1U << _orcaLocal[key].pos[i])) _orcaLocal[key].actual[p] |= 1U << i;
+	}
+    }
+
+    // The terms of each orbit's f. If S's node x is at canonical position q, then each automorphism alpha of S's
+    // type with alpha(q)=p is an isomorphism taking x to p, under which M is found at positions alpha^-1(M).
+    TINY_GRAPH *g = TinyGraphAlloc(k);
+    int edges[ORCA_MAX_ORBITS];
+    memset(_orcaNumTerms, 0, sizeof(_orcaNumTerms));
+    _orcaNumSolve = 0;
+    for(o=0; o<_numOrbits; o++) {
+	int c = _orbitCanonMapping[o], x = _orbitCanonNodeMapping[o], bestV = -1;
+	if(!SetIn(_connectedCanonicals, c)) continue;
+	edges[o] = OrcaCanonAdjacency(g, c, adj);
+	for(v=0; v<k; v++) // remove the lowest-degree node that leaves H connected; fewer attachments are cheaper to count
+	    if(v != x && OrcaConnected(adj, ((1U << k) - 1) & ~(1U << v)) &&
+		(bestV < 0 || __builtin_popcount(adj[v]) < __builtin_popcount(adj[bestV]))) bestV = v;
+	assert(bestV >= 0);
+	key = OrcaSplit(adj, bestV, S, &attach);
+	t = _orcaLocal[key].type;
+	int pos = _orcaLocal[key].pos[OrcaIndexOf(S, x)];
+	unsigned M = OrcaPermuteMask(attach, _orcaLocal[key].pos);
+	for(p=0; p<_orcaNumPerms; p++) if(OrcaPermuteKey(_orcaTypeKey[t], _orcaPerm[p]) == _orcaTypeKey[t]) {
+	    char inverse[ORCA_MAX_M];
+	    for(i=0; i<m; i++) inverse[(int)_orcaPerm[p][i]] = i;
+	    OrcaAddTerm(t, inverse[pos], o, OrcaPermuteMask(M, inverse));
+	}
+	_orcaOrder[_orcaNumSolve++] = o;
+    }
+
+    // A[o][o2]: o's count f on the k-graphlet around a node in orbit o2, adding in every way to split it into S and v.
+    static long A[ORCA_MAX_ORBITS][ORCA_MAX_ORBITS];
+    memset(A, 0, sizeof(A));
+    for(i=0; i<_orcaNumSolve; i++) {
+	int c, x;
+	o2 = _orcaOrder[i]; c = _orbitCanonMapping[o2]; x = _orbitCanonNodeMapping[o2];
+	OrcaCanonAdjacency(g, c, adj);
+	for(v=0; v<k; v++) if(v != x && OrcaConnected(adj, ((1U << k) - 1) & ~(1U << v))) {
+	    key = OrcaSplit(adj, v, S, &attach);
+	    t = _orcaLocal[key].type;
+	    int q = _orcaLocal[key].pos[OrcaIndexOf(S, x)];
+	    for(j=0; j<_orcaNumTerms[t][q]; j++) {
+		ORCA_TERM *term = &_orcaTerm[t][q][j];
+		unsigned need = _orcaLocal[key].actual[term->mask];
+		if((attach & need) == need) A[term->orbit][o2] += term->mult;
+	    }
+	}
+    }
+    TinyGraphFree(g);
+
+    // Solve densest first: A is triangular in that order (see above), which we check rather than assume.
+    for(i=0; i<_orcaNumSolve; i++) for(j=i+1; j<_orcaNumSolve; j++)
+	if(edges[_orcaOrder[j]] > edges[_orcaOrder[i]]) { o = _orcaOrder[i]; _orcaOrder[i] = _orcaOrder[j]; _orcaOrder[j] = o; }
+    for(i=0; i<_orcaNumSolve; i++) {
+	o = _orcaOrder[i];
+	_orcaDiag[o] = A[o][o];
+	assert(_orcaDiag[o] > 0);
+	_orcaNumOff[o] = 0;
+	for(j=0; j<_orcaNumSolve; j++) {
+	    o2 = _orcaOrder[j];
+	    if(o2 == o || !A[o][o2]) continue;
+	    assert(edges[o2] > edges[o]);
+	    _orcaOffOrbit[o][_orcaNumOff[o]] = o2;
+	    _orcaOffCoef[o][_orcaNumOff[o]++] = A[o][o2];
+	}
+    }
+}
+
+// The common neighbors of a set T of 2 or 3 nodes are needed again for every S that contains T, so (like ORCA) we
+// remember them. There can be far too many such T to remember them all, but ESU finds the S around a root together,
+// so a fixed-size direct-mapped cache keyed on T's sorted nodes catches most repeats. Its size follows the graph:
+// about k entries per edge, rounded up to a power of two, so that small graphs don't pay for the largest cache.
+#define ORCA_COMMON_CACHE_MIN_BITS 10
+#define ORCA_COMMON_CACHE_MAX_BITS 22 // 4M entries of 24 bytes per process
+typedef struct { unsigned long key[2]; long count; } ORCA_COMMON;
+static ORCA_COMMON *_orcaCommon;
+static int _orcaCommonBits;
+#define ORCA_COMMON_EMPTY (~0UL)
+
+// Number of nodes adjacent to all of T[0..size-1]: cached, or counted by scanning the lowest-degree node's neighbors.
+static long OrcaCommonCount(GRAPH *G, unsigned T[], int size)
+{
+    int i, j, t = 0;
+    unsigned long key[2];
+    ORCA_COMMON *slot;
+    for(i=1; i<size; i++) { // sort T (insertion sort; it's tiny)
+	unsigned u = T[i];
+	for(j=i; j>0 && T[j-1] > u; j--) T[j] = T[j-1];
+	T[j] = u;
+    }
+    key[0] = (unsigned long)T[0] * G->n + T[1];
+    key[1] = size == 3 ? T[2] : G->n;
+    if(!_orcaCommon) {
+	unsigned long l;
+	_orcaCommonBits = ORCA_COMMON_CACHE_MIN_BITS;
+	while(_orcaCommonBits < ORCA_COMMON_CACHE_MAX_BITS && (1UL << _orcaCommonBits) < (unsigned long)_k * G->numEdges)
+	    _orcaCommonBits++;
+	_orcaCommon = Malloc((1UL << _orcaCommonBits) * sizeof(ORCA_COMMON));
+	for(l=0; l < (1UL << _orcaCommonBits); l++) _orcaCommon[l].key[0] = ORCA_COMMON_EMPTY;
+    }
+    slot = &_orcaCommon[((key[0] * 0x9E3779B97F4A7C15UL) ^ key[1]) * 0x9E3779B97F4A7C15UL >> (64 - _orcaCommonBits)];
+    if(slot->key[0] != key[0] || slot->key[1] != key[1]) {
+	slot->key[0] = key[0]; slot->key[1] = key[1];
+	slot->count = 0;
+	for(i=1; i<size; i++) if(G->degree[T[i]] < G->degree[T[t]]) t = i;
+	for(j=0; j<G->degree[T[t]]; j++) {
+	    int w = G->neighbor[T[t]][j];
+	    for(i=0; i<size; i++) if(i != t && !SetIn(G->A[T[i]], w)) break;
+	    if(i == size) slot->count++;
+	}
+    }
+    return slot->count;
+}
+
+// Number of nodes outside S (Varray[0..m-1], induced as g) adjacent to all the nodes of S in mask.
+static long OrcaCommonNeighbors(GRAPH *G, unsigned Varray[], int m, TINY_GRAPH *g, unsigned mask)
+{
+    int i, j, size = 0, inside = 0;
+    unsigned T[ORCA_MAX_M];
+    long count = 0;
+    for(i=0; i<m; i++) {
+	if(mask & (1U << i)) T[size++] = Varray[i];
+	else if((g->A[i] & mask) == mask) inside++;
+    }
+    if(size == 1) return G->degree[T[0]] - inside;
+    if(size < 4) return OrcaCommonCount(G, T, size) - inside;
+    for(i=1; i<size; i++) if(G->degree[T[i]] < G->degree[T[0]]) { unsigned u = T[0]; T[0] = T[i]; T[i] = u; }
+    for(j=0; j<G->degree[T[0]]; j++) { // all of S; these are rare enough that it doesn't pay to remember them
+	int w = G->neighbor[T[0]][j];
+	for(i=1; i<size; i++) if(!SetIn(G->A[T[i]], w)) break;
+	if(i == size) count++;
+    }
+    return count - inside;
+}
+
+void OrcaVisit(GRAPH *G, unsigned Varray[], int m, TINY_GRAPH *g)
+{
+    int i, j, key = 0;
+    unsigned known = 0;
+    long count[1 << ORCA_MAX_M];
+    assert(m == _orcaM);
+    for(i=0; i<m; i++) for(j=i+1; j<m; j++) if(TSetIn(g->A[i], j)) key |= 1 << _orcaPairBit[i][j];
+    int t = _orcaLocal[key].type;
+    for(i=0; i<m; i++) {
+	int q = _orcaLocal[key].pos[i];
+	for(j=0; j<_orcaNumTerms[t][q]; j++) {
+	    ORCA_TERM *term = &_orcaTerm[t][q][j];
+	    unsigned mask = _orcaLocal[key].actual[term->mask];
+	    if(!(known & (1U << mask))) { count[mask] = OrcaCommonNeighbors(G, Varray, m, g, mask); known |= 1U << mask; }
+	    ADD_ODV(Varray[i], term->orbit, term->mult * count[mask]);
+	}
+    }
+}
+
+void OrcaSolve(GRAPH *G)
+{
+    int x, i, j;
+    for(x=0; x<G->n; x++) for(i=0; i<_orcaNumSolve; i++) {
+	int o = _orcaOrder[i];
+	unsigned long f = ODV(x, o);
+	for(j=0; j<_orcaNumOff[o]; j++) f -= _orcaOffCoef[o][j] * ODV(x, _orcaOffOrbit[o][j]);
+	assert(f % _orcaDiag[o] == 0);
+	SET_ODV(x, o, f / _orcaDiag[o]);
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef BLANT_ORCA_H
+#define BLANT_ORCA_H
+#include "blant.h"
+
+// -s EXACT -mo for k=3..5 counts orbits with ORCA-style equations over the (k-1)-graphlets, instead of enumerating
+// every k-graphlet. Set to 0 to use plain enumeration (ESU) for -mo too, eg. to cross-check the two.
+#define USE_ORCA_EQUATIONS 1
+
+Boolean OrcaEquationsApply(int k); // whether -s EXACT should use the equations rather than ESU
+void OrcaInit(int k);
+void OrcaVisit(GRAPH *G, unsigned Varray[], int m, TINY_GRAPH *g); // ESU_VISITOR on (k-1)-graphlets: accumulates into ODV
+void OrcaSolve(GRAPH *G); // turns the accumulated counts into orbit degrees, in place
+
+#endif
@@ -1,10 +1,20 @@
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
 #include "blant.h"
 #include "blant-output.h"
+#include "blant-index-format.h"
 #if PREDICT
 #include "EdgePredict/blant-predict.h"
 #endif
 #include "blant-utils.h"
 #include "blant-sampling.h"
+#include "blant-dedup.h"
 
 char *PrintNode(char c, int v) {
     static char buf[BUFSIZ];
@@ -72,145 +82,635 @@ char *PrintCanonical(int GintOrdinal)
     return buf;
 }
 
-// Below is code to help reduce (mostly eliminite if we're lucky) MCMC's duplicate output, which is copious
-// Empirically I've found that neither of these need to be very big since most repetition happens with high locality
-//#define MCMC_PREDICT_CIRC_BUF 999983 // prime, not sure it needs to be but why not... 1M * 4b = 4MB RAM.
-#define MCMC_PREDICT_CIRC_BUF 134217689 // 2^27-39, prime according to https://www.dcode.fr/closest-prime-number (512MB)
-
-// But apparently the above are too big, not sure why, but they cause seg faults.
-//#define MCMC_PREDICT_MAX_HASH 1610612741U // about 1.6 billion, taken from https://planetmath.org/goodhashtableprimes
-//#define MCMC_PREDICT_MAX_HASH  402653189U // halfway from 2^28 to 2^29 (works)
-//#define MCMC_PREDICT_MAX_HASH  805306457U // halfway from 2^29 to 2^30 (works)
-//#define MCMC_PREDICT_MAX_HASH 1610612741U // halfway from 2^30 to 2^31 (works)
-
-// Below is simply the largest number in the list at:
-// https://github.com/leventov/Koloboke/lib/impl/src/main/java/net/openhft/koloboke/collect/impl/hash/DHashCapacities.java
-#define MCMC_PREDICT_MAX_HASH 2136745621U // about 1% smaller than 2^31.
-
-// The following is > 2^32, and would requires a SET implementation allowing members with value > 32 bits.
-//#define MCMC_PREDICT_MAX_HASH 8589934591UL // 2^33-9, according to https://www.dcode.fr/closest-prime-number; about 1GB
-                              
+// Below is code to help reduce (mostly eliminite if we're lucky) MCMC's duplicate output, which is copious.
+// Empirically most repetition happens with high locality, so we only need to remember the recent node sets; see
+// blant-dedup.h for how, and how many. The fingerprint is a 64-bit hash of the sorted nodes, so a false positive
+// (a new node set dropped as a duplicate) has probability about (fingerprints in the table)/2^64 per lookup.
 // NOTE WE DO NOT CHECK EDGES. So if you call it with the same node set but as a motif, it'll (incorrectly) return TRUE
 Boolean NodeSetSeenRecently(GRAPH *G, unsigned Varray[], int k) {
-    static unsigned circBuf[MCMC_PREDICT_CIRC_BUF], bufPos;
-    static SET *seen;
     static unsigned Vcopy[MAX_K];
-    if(!seen) seen=SetAlloc(MCMC_PREDICT_MAX_HASH);
+    unsigned long hash = 0;
+    int i;
+    if(_dedupMegabytes == 0) return false;
     memcpy(Vcopy, Varray, k*sizeof(*Varray));
     VarraySort(Vcopy, k);
-    unsigned hash=Vcopy[0], i;
-    for(i=1;i<k;i++) hash = hash*G->n + Vcopy[i]; // Yes this will likely overflow. Shouldn't matter.
-    hash = hash % MCMC_PREDICT_MAX_HASH;
-    if(SetInSafe(seen, hash)) return true; // of course false positives are possible but we hope they are rare.
-    //for(i=0;i<k;i++) printf("%d ", Vcopy[i]); printf("\thash %d\n",hash); // checking for rareness.
-    SetDelete(seen, circBuf[bufPos]); // this set hasn't been seen in at least the last MCMC_PREDICT_CIRC_BUF samples
-    circBuf[bufPos] = hash;
-    SetAdd(seen, hash);
-    if(++bufPos >= MCMC_PREDICT_CIRC_BUF) bufPos=0;
-    return false;
+    for(i=0;i<k;i++) hash = (hash ^ Vcopy[i]) * 0x9E3779B97F4A7C15UL;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9UL; // splitmix64's finalizer, so that all 64 bits are mixed
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBUL;
+    return DedupSeen(hash ^ (hash >> 31));
+}
+
+// Index lines are by far our largest output, so they bypass both stdio and the Print* functions above: each line is
+// assembled in place at the end of _indexOut, from node names and canonical IDs whose text (or at least length) was
+// worked out once by IndexOutputInit, and the whole buffer goes out in one write(2) when it fills up.
+// With binary output (see blant-index-format.h), records are instead collected a block at a time, column by column,
+// and then copied to _indexOut in the layout asked for.
+int _indexFormat; // 0 for text, else BLANT_INDEX_ROWS or BLANT_INDEX_COLUMNS
+static unsigned short _blockOrdinal[BLANT_INDEX_BLOCK];
+static unsigned _blockNode[MAX_K][BLANT_INDEX_BLOCK], _blockCount;
+static unsigned long _indexRecords; // in blocks already put in _indexOut
+static char *_indexOut;
+static size_t _indexOutLength, _indexLineMax; // _indexLineMax bounds the length of one line, newline included
+static unsigned short *_nodeNameLength; // strlen(_nodeNames[v]), only if _supportNodeNames
+static char *_canonText[MAX_CANONICALS]; // PrintCanonical(i), and its length
+static unsigned char _canonTextLength[MAX_CANONICALS];
+static const char _digitPairs[] = // "00" through "99"
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static void WriteAll(const char *s, size_t length)
+{
+    size_t done = 0;
+    while(done < length) {
+	ssize_t n = write(1, s + done, length - done);
+	if(n < 0 && errno == EINTR) continue;
+	if(n <= 0) Fatal("write to stdout failed: %s", strerror(errno));
+	done += n;
+    }
+}
+
+// With ASYNC_INDEX_OUTPUT, the top-level process doesn't write _indexOut itself: it hands it to a writer process, and
+// carries on filling another buffer meanwhile, so that sampling needn't wait for stdout (a pipe to gzip, say, or a
+// slow filesystem). The two buffers are shared memory, and take turns; we only wait when the writer hasn't finished
+// the previous one by the time the next is full, and report at the end how long that was, which is the time that
+// writing actually cost us.
+static struct {
+    int pid, toWriter, fromWriter; // pipes: which buffer to write and how much, and the writer's "done"
+    char *buffer[2];
+    int current, inFlight; // the buffer we're filling, and the one being written (-1 if none)
+    long buffers; unsigned long bytes; double waited; // for the report
+} _writer;
+typedef struct _writerRequest { int which; size_t length; } WRITER_REQUEST;
+
+static double WriterClock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+// If the writer died of a signal (SIGPIPE, most likely, if our output went to "head"), so do we, as we would have.
+static void WriterDied(void)
+{
+    int status;
+    if(waitpid(_writer.pid, &status, 0) == _writer.pid && WIFSIGNALED(status)) {
+	signal(WTERMSIG(status), SIG_DFL);
+	raise(WTERMSIG(status));
+    }
+    Fatal("the output writer process died");
+}
+
+static void WriterStart(void)
+{
+    int to[2], from[2], i;
+    WRITER_REQUEST request;
+    for(i=0; i<2; i++) {
+	_writer.buffer[i] = mmap(NULL, INDEX_OUTPUT_BYTES, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if(_writer.buffer[i] == MAP_FAILED) Fatal("cannot allocate output buffers: %s", strerror(errno));
+    }
+    if(pipe(to) < 0 || pipe(from) < 0) Fatal("cannot create the output writer's pipes: %s", strerror(errno));
+    fflush(stdout);
+    _writer.pid = fork();
+    if(_writer.pid < 0) Fatal("cannot fork the output writer: %s", strerror(errno));
+    if(_writer.pid == 0) {
+	close(to[1]); close(from[0]);
+	while(read(to[0], &request, sizeof(request)) == sizeof(request)) {
+	    WriteAll(_writer.buffer[request.which], request.length);
+	    if(write(from[1], "", 1) != 1) break;
+	}
+	_exit(0); // not exit, which would flush our copy of the parent's stdio buffers
+    }
+    close(to[0]); close(from[1]);
+    _writer.toWriter = to[1];
+    _writer.fromWriter = from[0];
+    _writer.current = 0;
+    _writer.inFlight = -1;
+    _indexOut = _writer.buffer[0];
+}
+
+static void WriterWait(void)
+{
+    char done;
+    if(!_writer.pid || _writer.inFlight < 0) return;
+    double start = WriterClock();
+    if(read(_writer.fromWriter, &done, 1) != 1) WriterDied();
+    _writer.waited += WriterClock() - start;
+    _writer.inFlight = -1;
+}
+
+// Pass _indexOut to the writer, and switch to the other buffer, once the writer's done with it.
+static void WriterSend(void)
+{
+    WRITER_REQUEST request = {_writer.current, _indexOutLength};
+    WriterWait();
+    if(write(_writer.toWriter, &request, sizeof(request)) != sizeof(request)) WriterDied();
+    _writer.inFlight = _writer.current;
+    _writer.current = 1 - _writer.current;
+    _indexOut = _writer.buffer[_writer.current];
+    _indexOutLength = 0;
+    ++_writer.buffers;
+    _writer.bytes += request.length;
+}
+
+static void WriterStop(void)
+{
+    int status, i;
+    WriterWait();
+    close(_writer.toWriter);
+    if(waitpid(_writer.pid, &status, 0) != _writer.pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) WriterDied();
+    close(_writer.fromWriter);
+    if(_writer.buffers) Note("output writer: %.1f MB in %ld buffers; sampling waited %.3f seconds for it",
+	_writer.bytes / 1048576.0, _writer.buffers, _writer.waited);
+    for(i=0; i<2; i++) munmap(_writer.buffer[i], INDEX_OUTPUT_BYTES);
+    memset(&_writer, 0, sizeof(_writer));
+    _indexOut = NULL;
+}
+
+void IndexOutputDetach(void)
+{
+    if(!_writer.pid) return;
+    assert(_indexOutLength == 0);
+    close(_writer.toWriter);
+    close(_writer.fromWriter);
+    memset(&_writer, 0, sizeof(_writer));
+    _indexOut = NULL;
+}
+
+// Write _indexOut, or with the writer, start it being written.
+static void WriteIndexOutput(void)
+{
+    if(_writer.pid) {
+	if(_indexOutLength) WriterSend();
+	return;
+    }
+    fflush(stdout); // anything that went through stdio came first
+    WriteAll(_indexOut, _indexOutLength);
+    _indexOutLength = 0;
+}
+
+// Make room for the given number of bytes at the end of _indexOut, and return where they go.
+static char *IndexOutputReserve(size_t bytes)
+{
+    assert(bytes <= INDEX_OUTPUT_BYTES);
+    if(!_indexOut) {
+	if(ASYNC_INDEX_OUTPUT && !_child) WriterStart();
+	else _indexOut = Malloc(INDEX_OUTPUT_BYTES);
+    }
+    if(_indexOutLength + bytes > INDEX_OUTPUT_BYTES) WriteIndexOutput();
+    return _indexOut + _indexOutLength;
 }
 
-char *PrintIndexEntry(int Gint, int GintOrdinal, unsigned Varray[], TINY_GRAPH *g, int k)
+static void PutBytes(const void *p, size_t bytes)
 {
+    memcpy(IndexOutputReserve(bytes), p, bytes);
+    _indexOutLength += bytes;
+}
+
+// The integer types of the binary format are little-endian, like the machines we run on; we check in IndexOutputInit.
+static void PutUnsigned(unsigned long value, int bytes) { PutBytes(&value, bytes); }
+
+static void PutIndexHeader(GRAPH *G, long numSamples)
+{
+    int i;
+    char displayMode = 'i';
+    switch(_displayMode) {
+    case undefined: case ordinal: displayMode = 'i'; break;
+    case decimal: displayMode = 'd'; break;
+    case binary: displayMode = 'b'; break;
+    case orca: displayMode = 'o'; break;
+    case jesse: displayMode = 'j'; break;
+    }
+    PutBytes(BLANT_INDEX_MAGIC, strlen(BLANT_INDEX_MAGIC));
+    PutUnsigned(_k, 4);
+    PutUnsigned(_indexFormat, 4);
+    PutUnsigned(displayMode, 1);
+    PutUnsigned(numSamples, 8);
+    PutUnsigned(_numCanon, 4);
+    for(i=0; i<_numCanon; i++) { PutUnsigned(_canonTextLength[i], 1); PutBytes(_canonText[i], _canonTextLength[i]); }
+    PutUnsigned(_supportNodeNames ? G->n : 0, 4);
+    if(_supportNodeNames) for(i=0; i<G->n; i++) {
+	PutUnsigned(_nodeNameLength[i], 2);
+	PutBytes(_nodeNames[i], _nodeNameLength[i]);
+    }
+}
+
+// Copy the records collected so far to _indexOut as one block.
+static void PutIndexBlock(void)
+{
+    unsigned i, count = _blockCount;
     int j;
+    PutUnsigned(count, 4);
+    if(_indexFormat == BLANT_INDEX_COLUMNS) {
+	PutBytes(_blockOrdinal, count * sizeof(_blockOrdinal[0]));
+	for(j=0; j<_k; j++) PutBytes(_blockNode[j], count * sizeof(_blockNode[j][0]));
+    }
+    else {
+	char *s = IndexOutputReserve(count * (2 + 4*_k));
+	for(i=0; i<count; i++) {
+	    memcpy(s, _blockOrdinal + i, 2); s += 2;
+	    for(j=0; j<_k; j++) { memcpy(s, _blockNode[j] + i, 4); s += 4; }
+	}
+	_indexOutLength = s - _indexOut;
+    }
+    _indexRecords += count;
+    _blockCount = 0;
+}
+
+void IndexOutputInit(GRAPH *G, long numSamples)
+{
+    static Boolean headerDone;
+    unsigned one = 1;
+    int i, nameMax = 10; // digits in the largest unsigned
+    if(_supportNodeNames) {
+	if(!_nodeNameLength) {
+	    _nodeNameLength = Malloc(G->n * sizeof(*_nodeNameLength));
+	    for(i=0; i<G->n; i++) {
+		size_t length = strlen(_nodeNames[i]);
+		if(length > USHRT_MAX) Fatal("node name \"%.20s...\" is too long (%lu characters)", _nodeNames[i], length);
+		_nodeNameLength[i] = length;
+	    }
+	}
+	for(nameMax=0, i=0; i<G->n; i++) nameMax = MAX(nameMax, _nodeNameLength[i]);
+    }
+    _indexLineMax = 0;
+    for(i=0; i<_numCanon; i++) {
+	if(!_canonText[i]) {
+	    _canonText[i] = strdup(PrintCanonical(i));
+	    _canonTextLength[i] = strlen(_canonText[i]);
+	}
+	_indexLineMax = MAX(_indexLineMax, _canonTextLength[i]);
+    }
+    _indexLineMax += _k * (1 + nameMax) + 1;
+    assert(_indexLineMax <= INDEX_OUTPUT_BYTES);
+    if(_indexFormat && !headerDone) {
+	if(*(char*)&one != 1) Fatal("binary index output is little-endian, and this machine isn't");
+	assert(BLANT_INDEX_BLOCK * (2 + 4*MAX_K) + 4 <= INDEX_OUTPUT_BYTES);
+	PutIndexHeader(G, numSamples);
+	headerDone = true;
+    }
+}
+
+void FlushIndexOutput(void)
+{
+    if(_blockCount) PutIndexBlock();
+    if(_writer.pid) { // wait for the writer both before (so stdio's output goes after what came first) and after
+	WriterWait();
+	fflush(stdout);
+    }
+    WriteIndexOutput();
+    WriterWait();
+}
+
+void IndexOutputFinish(void)
+{
+    if(_indexFormat) {
+	if(_blockCount) PutIndexBlock();
+	PutUnsigned(0, 4); // the end of the blocks
+	PutUnsigned(_indexRecords, 8);
+    }
+    FlushIndexOutput();
+    if(_writer.pid) WriterStop();
+}
+
+void PutIndexLine(const char *line)
+{
+    size_t length = strlen(line);
+    assert(!_indexFormat);
+    if(length > INDEX_OUTPUT_BYTES) { FlushIndexOutput(); fputs(line, stdout); return; } // in order, since we wrote first
+    PutBytes(line, length);
+}
+
+// Start an index line with the canonical ID, making sure the rest of it will fit.
+static char *PutIndexLineStart(int GintOrdinal)
+{
+    assert(_indexLineMax > 0); // ie., IndexOutputInit has been called
+    char *s = IndexOutputReserve(_indexLineMax);
+    memcpy(s, _canonText[GintOrdinal], _canonTextLength[GintOrdinal]);
+    return s + _canonTextLength[GintOrdinal];
+}
+
+// Put v in decimal at s, and return the end.
+static char *PutDecimal(char *s, unsigned long v)
+{
+    char digits[20], *d = digits + sizeof(digits); // v's digits, two at a time from the right
+    while(v >= 100) { d -= 2; memcpy(d, _digitPairs + 2*(v % 100), 2); v /= 100; }
+    if(v >= 10) { d -= 2; memcpy(d, _digitPairs + 2*v, 2); }
+    else *--d = '0' + v;
+    memcpy(s, d, digits + sizeof(digits) - d);
+    return s + (digits + sizeof(digits) - d);
+}
+
+// Put node v at s, preceded by c (unless it's 0), and return the end; the same text as PrintNode(c,v).
+static char *PutNode(char *s, char c, unsigned v)
+{
+    if(c) *s++ = c;
+    if(_supportNodeNames) {
+	memcpy(s, _nodeNames[v], _nodeNameLength[v]);
+	return s + _nodeNameLength[v];
+    }
+    return PutDecimal(s, v);
+}
+
+static void PutIndexLineEnd(char *s)
+{
+    *s++ = '\n';
+    _indexOutLength = s - _indexOut;
+    assert(_indexOutLength <= INDEX_OUTPUT_BYTES);
+}
+
+// perm[j] is the index into Varray of canonical node j.
+static void PutIndexEntryPerm(int GintOrdinal, const char perm[], unsigned Varray[], int k)
+{
+    int j;
+    if(_indexFormat) {
+	_blockOrdinal[_blockCount] = GintOrdinal;
+	for(j=0;j<k;j++) _blockNode[j][_blockCount] = Varray[(int)perm[j]];
+	if(++_blockCount == BLANT_INDEX_BLOCK) PutIndexBlock();
+	return;
+    }
+    char *s = PutIndexLineStart(GintOrdinal);
+    for(j=0;j<k;j++) s = PutNode(s, ' ', Varray[(int)perm[j]]);
+    PutIndexLineEnd(s);
+}
+
+static void PutIndexEntry(int Gint, int GintOrdinal, unsigned Varray[], TINY_GRAPH *g, int k)
+{
     char perm[MAX_K];
     memset(perm, 0, k);
     ExtractPerm(perm, Gint);
     assert(PERMS_CAN2NON);
-    static char buf[2][BUFSIZ];
-    int which=0;
-    strcpy(buf[which], PrintCanonical(GintOrdinal));
-    for(j=0;j<k;j++) {
-	which=1-which; sprintf(buf[which], "%s%s", buf[1-which], PrintNode(' ', Varray[(int)perm[j]]));
+    PutIndexEntryPerm(GintOrdinal, perm, Varray, k);
+}
+
+static void PutIndexOrbitsEntryPerm(int GintOrdinal, const char perm[], unsigned Varray[], int k) {
+    int j, j1;
+    unsigned printed = 0; // bit j is set once canonical node j has been printed
+    char *s = PutIndexLineStart(GintOrdinal);
+    for(j=0;j<k;j++) if(!(printed & (1U << j)))
+    {
+	s = PutNode(s, ' ', Varray[(int)perm[j]]);
+	printed |= 1U << j;
+	for(j1=j+1;j1<k;j1++) if(_orbitList[GintOrdinal][j1] == _orbitList[GintOrdinal][j])
+	{
+	    assert(!(printed & (1U << j1)));
+	    s = PutNode(s, ':', Varray[(int)perm[j1]]);
+	    printed |= 1U << j1;
+	}
     }
-    return buf[which];
+    PutIndexLineEnd(s);
 }
 
-char *PrintIndexOrbitsEntry(int Gint, int GintOrdinal, unsigned Varray[], TINY_GRAPH *g, int k) {
+static void PutIndexOrbitsEntry(int Gint, int GintOrdinal, unsigned Varray[], TINY_GRAPH *g, int k) {
     assert(TinyGraphDFSConnected(g,0));
-    int j;
-    static SET* printed;
-    if(!printed) printed = SetAlloc(k);
-    SetEmpty(printed);
     char perm[MAX_K+1];
     memset(perm, 0, k);
     ExtractPerm(perm, Gint);
-    static char buf[2][BUFSIZ];
-    int which=0;
-    strcpy(buf[which], PrintCanonical(GintOrdinal));
     assert(PERMS_CAN2NON); // Apology("Um, don't we need to check PERMS_CAN2NON? See outputODV for correct example");
-    for(j=0;j<k;j++) if(!SetIn(printed,j))
-    {
-	which=1-which; sprintf(buf[which], "%s%s", buf[1-which], PrintNode(' ', Varray[(int)perm[j]]));
-	SetAdd(printed, j);
-	int j1;
-	for(j1=j+1;j1<k;j1++) if(_orbitList[GintOrdinal][j1] == _orbitList[GintOrdinal][j])
-	{
-	    assert(!SetIn(printed, j1));
-	    which=1-which; sprintf(buf[which], "%s%s", buf[1-which], PrintNode(':', Varray[(int)perm[j1]]));
-	    SetAdd(printed, j1);
+    PutIndexOrbitsEntryPerm(GintOrdinal, perm, Varray, k);
+}
+
+// -mg and -mo output: a line per node, of its counts. With large k or n that's a lot of numbers, so we format them
+// by hand rather than with printf, and with -t the rows are split into a block per thread, each formatted in memory by
+// a forked worker, which writes it to stdout when its turn comes. Children always send their parent sparse lines.
+Boolean _sparseDegreeVectors; // -m{g|o}s: only the nonzero counts, as column:count
+#define DEGREE_VECTOR_ROWS_PER_WORKER 1024 // at least
+typedef struct _textBuffer { char *s; size_t length, size; Boolean flush; } TEXT_BUFFER; // flush: write when full
+
+static char *TextReserve(TEXT_BUFFER *b, size_t bytes)
+{
+    if(b->length + bytes > b->size && b->flush && b->length) { WriteAll(b->s, b->length); b->length = 0; }
+    if(b->length + bytes > b->size)
+	b->s = Realloc(b->s, b->size = MAX(b->length + bytes, MAX(2*b->size, INDEX_OUTPUT_BYTES)));
+    return b->s + b->length;
+}
+
+// The same text as printf("%.12f", x). By hand, we round x's last 12 decimals in double precision, with an error below
+// 1e-4 of the last digit; so if that's too close to halfway to tell which way the exact value rounds, we ask printf.
+static void PutFixed12(TEXT_BUFFER *b, double x)
+{
+    if(x >= 0 && !signbit(x) && x < 1e15) {
+	double whole = floor(x), scaled = (x - whole) * 1e12; // x - whole is exact
+	if(fabs(scaled - floor(scaled) - 0.5) > 1e-3) {
+	    unsigned long w = whole, f = scaled + 0.5;
+	    char *s = TextReserve(b, 40);
+	    int j;
+	    if(f == 1000000000000UL) { ++w; f = 0; }
+	    s = PutDecimal(s, w);
+	    *s++ = '.';
+	    for(j=11; j>=0; j--) { s[j] = '0' + f % 10; f /= 10; }
+	    b->length = s + 12 - b->s;
+	    return;
 	}
     }
-    return buf[which];
+    int length = snprintf(NULL, 0, "%.12f", x);
+    sprintf(TextReserve(b, length + 1), "%.12f", x);
+    b->length += length;
 }
 
-// Recursively print all the motifs under this graphlet. Note that this one actually outputs directly, it does
-// ** not ** print into a buffer and return a char*.
-void PrintAllMotifs(TINY_GRAPH *g, int Gint, int GintOrdinal, GRAPH *G, unsigned Varray[])
+static void PutDegreeVectorRows(TEXT_BUFFER *b, GRAPH *G, int k, int from, int to)
 {
-    static int depth;
-    static Boolean initDone;
-    static SET *seen; // size 2^B(k), *not* canonical but a specific set of nodes and edges in the *top* graphlet
-    if(!initDone) {
-	assert(_Bk>0);
-	seen = SetAlloc(_Bk);
-	assert(_k>= 3 && _k <= 8);
-	initDone = true;
+    Boolean sparse = _sparseDegreeVectors || _child;
+    Boolean doubles = (_outputMode == outputODV && _MCMC_EVERY_EDGE && _sampleMethod == SAMPLE_MCMC);
+    NODE_COUNTS *c = (_outputMode == outputGDV) ? &_graphletDegreeVector : &_orbitDegreeVector;
+    int columns = (_outputMode == outputGDV) ? _numCanon : _numConnectedOrbits, id[columns], v, j;
+    for(j=0; j<columns; j++) { // the graphlet or orbit in each column of the output
+	if(_outputMode == outputGDV) id[j] = j;
+	else if (k == 4 || k == 5) id[j] = _connectedOrbits[_orca_orbit_mapping[j]];
+	else id[j] = _connectedOrbits[j];
     }
-
-    if(depth==0) {
-	SetReset(seen);
+    unsigned long *row = doubles ? NULL : Malloc(c->columns * sizeof(*row)); // one node's counts
+    for(v=from; v<to; v++) {
+	// room for the node and the newline, and all the integers (at most 32 characters each, with a column number)
+	char *s = TextReserve(b, (_supportNodeNames ? _nodeNameLength[v] : 20) + (doubles ? 0 : 32*columns) + 1);
+	s = PutNode(s, 0, v);
+	if(doubles) for(j=0; j<columns; j++) {
+	    double x = _doubleOrbitDegreeVector[id[j]][v];
+	    if(sparse && !x) continue;
+	    b->length = s - b->s;
+	    s = TextReserve(b, 32);
+	    *s++ = ' ';
+	    if(sparse) { s = PutDecimal(s, j); *s++ = ':'; }
+	    b->length = s - b->s;
+	    PutFixed12(b, x);
+	    s = TextReserve(b, 1); // for the newline
+	}
+	else {
+	    NodeCountsRow(c, v, row);
+	    for(j=0; j<columns; j++) {
+		unsigned long x = c->column[id[j]] < 0 ? 0 : row[c->column[id[j]]];
+		if(sparse && !x) continue;
+		*s++ = ' ';
+		if(sparse) { s = PutDecimal(s, j); *s++ = ':'; }
+		s = PutDecimal(s, x);
+	    }
+	}
+	*s++ = '\n';
+	b->length = s - b->s;
     }
+    if(row) Free(row);
+}
 
-#if PARANOID_ASSERTS
-    assert(g->n == _k);
-    assert(TinyGraphDFSConnected(g, 0));
-#endif
+void PrintDegreeVectors(GRAPH *G, int k)
+{
+    NODE_COUNTS *c = (_outputMode == outputGDV) ? &_graphletDegreeVector : &_orbitDegreeVector;
+    int workers = (_child || _JOBS == 1) ? 1 : MIN(_MAX_THREADS, (G->n + DEGREE_VECTOR_ROWS_PER_WORKER - 1) / DEGREE_VECTOR_ROWS_PER_WORKER);
+    int go[MAX_POSSIBLE_THREADS][2], pid[MAX_POSSIBLE_THREADS], w;
+    TEXT_BUFFER b = {NULL, 0, 0, false};
+    assert(_outputMode == outputGDV || _outputMode == outputODV);
+    if(c->queued) ApplyNodeCountsQueue(c); // once, rather than in every worker
+    IndexOutputInit(G, 0); // for PutNode
+    FlushIndexOutput();
+    if(workers <= 1) {
+	b.flush = true;
+	PutDegreeVectorRows(&b, G, k, 0, G->n);
+	WriteAll(b.s, b.length);
+	Free(b.s);
+	return;
+    }
+    for(w=0; w<workers; w++) {
+	assert(pipe(go[w]) >= 0);
+	pid[w] = fork();
+	if(pid[w] < 0) Fatal("PrintDegreeVectors: fork failed: %s", strerror(errno));
+	if(pid[w] == 0) { // format our block, then wait for the go-ahead to write it
+	    char token;
+	    int i;
+	    for(i=0; i<=w; i++) close(go[i][1]); // so that we see EOF rather than block forever if the parent dies
+	    PutDegreeVectorRows(&b, G, k, (long)G->n * w / workers, (long)G->n * (w+1) / workers);
+	    if(read(go[w][0], &token, 1) != 1) _exit(1);
+	    WriteAll(b.s, b.length);
+	    _exit(0);
+	}
+	close(go[w][0]);
+    }
+    for(w=0; w<workers; w++) { // in order
+	int status;
+	if(write(go[w][1], "", 1) != 1) Fatal("PrintDegreeVectors: can't start worker %d: %s", w, strerror(errno));
+	close(go[w][1]);
+	if(waitpid(pid[w], &status, 0) < 0) Fatal("PrintDegreeVectors: lost worker %d: %s", w, strerror(errno));
+	if(WIFSIGNALED(status)) { // eg., SIGPIPE because our reader quit early: die the same way, quietly
+	    signal(WTERMSIG(status), SIG_DFL);
+	    raise(WTERMSIG(status));
+	}
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	    Fatal("PrintDegreeVectors: worker %d failed", w);
+    }
+}
 
-    if(SetIn(seen,Gint)) return;
-    SetAdd(seen,Gint);
+// The motifs under a canonical graphlet are its connected spanning subgraphs: delete any set of its edges that leaves
+// it connected. We list them once per canonical, in the canonical's own node order, together with their ordinals and
+// the permutation that takes each one's canonical nodes to the parent's. Printing the motifs of a sample is then a
+// walk down that list, composing each permutation with the sample's, with no canon map lookups at all.
+// NOTE the list for a dense canonical is long: K_k has every connected graph on k labeled nodes under it (26704 for
+// k=6, 1.8 million for k=7, 251 million for k=8); but then again that's how many lines we print every time we see it.
+// So we only keep a list of at most MOTIF_TABLE_MAX entries, and at most MOTIF_TABLES_MAX entries over all the lists,
+// which holds all of them up to k=7. A canonical whose list won't fit (ie., a dense one for k=8) instead repeats the
+// same depth-first walk below for every sample, printing as it goes, in the same order.
+#define MOTIF_TABLE_MAX (1<<21) // 24MB
+#define MOTIF_TABLES_MAX (1L<<24) // 200MB; all of k=7 takes 8.4 million
+typedef struct _motif { int ordinal; char perm[MAX_K]; } MOTIF; // perm[j] = node of the parent for canonical node j
+static MOTIF *_motifs[MAX_CANONICALS];
+static int _numMotifs[MAX_CANONICALS]; // -1 means the list didn't fit, so we walk the motifs of each sample
+static long _motifTableEntries; // over all the lists
 
+static void PutMotif(MOTIF *m, const char perm[], unsigned Varray[])
+{
+    char subPerm[MAX_K];
+    int j;
+    for(j=0; j<_k; j++) subPerm[j] = perm[(int)m->perm[j]];
     if(_outputMode == indexMotifOrbits)
-	puts(PrintIndexOrbitsEntry(Gint, GintOrdinal, Varray, g, _k));
+	PutIndexOrbitsEntryPerm(m->ordinal, subPerm, Varray, _k);
     else {
 	assert(_outputMode == indexMotifs);
-	puts(PrintIndexEntry(Gint, GintOrdinal, Varray, g, _k));
+	PutIndexEntryPerm(m->ordinal, subPerm, Varray, _k);
     }
+}
 
-    // Now go about deleting edges recursively.
-    int i,j;
-    for(i=0; i<_k-1; i++)for(j=i+1;j<_k;j++)
-    {
-	if(TinyGraphAreConnected(g,i,j)) // if it's an edge, delete it.
-	{
-	    TinyGraphDisconnect(g,i,j);
-	    Gint = TinyGraph2Int(g,_k);
-	    GintOrdinal = _K[Gint];
-	    if(SetIn(_connectedCanonicals, GintOrdinal)) {
-		++depth;
-		PrintAllMotifs(g,Gint,GintOrdinal, G,Varray);
-		--depth;
-	    }
-	    TinyGraphConnect(g,i,j);
-	}
+// Depth-first from the canonical graphlet g (in its own node order), deleting edges in increasing order of their
+// (i,j) position, from the firstEdge'th on. Every set of deleted edges is thus reached exactly once, and since deleting
+// fewer of them can't disconnect g, pruning at the first disconnected graph still reaches all the connected ones.
+// With a table we append to the list of canon, and give up (returning false) once it has maxEntries; without one, we
+// print each motif for the sample whose permutation is perm.
+static Boolean MotifLatticeVisit(TINY_GRAPH *g, int Gint, int firstEdge, int canon, int *space, int maxEntries,
+    const char perm[], unsigned Varray[])
+{
+    int i, j, edge = 0;
+    MOTIF motif, *m = &motif;
+    if(space) {
+	if(_numMotifs[canon] == maxEntries) return false;
+	if(_numMotifs[canon] == *space) _motifs[canon] = Realloc(_motifs[canon], (*space *= 2) * sizeof(MOTIF));
+	m = _motifs[canon] + _numMotifs[canon]++;
     }
+    m->ordinal = _K[Gint];
+    memset(m->perm, 0, _k);
+    ExtractPerm(m->perm, Gint);
+    if(!space) PutMotif(m, perm, Varray);
+    for(i=0; i<_k-1; i++) for(j=i+1; j<_k; j++, edge++) if(edge >= firstEdge && TinyGraphAreConnected(g,i,j)) {
+	TinyGraphDisconnect(g,i,j);
+	int sub = TinyGraph2Int(g,_k);
+	Boolean fits = !SetIn(_connectedCanonicals, _K[sub]) ||
+	    MotifLatticeVisit(g, sub, edge+1, canon, space, maxEntries, perm, Varray);
+	TinyGraphConnect(g,i,j);
+	if(!fits) return false;
+    }
+    return true;
+}
+
+static void MotifLatticeBuild(int canon)
+{
+    static TINY_GRAPH *g;
+    int space = 16, maxEntries = MIN(MOTIF_TABLE_MAX, MOTIF_TABLES_MAX - _motifTableEntries);
+    if(!g) g = TinyGraphAlloc(_k);
+    _motifs[canon] = Malloc(space * sizeof(MOTIF));
+    Int2TinyGraph(g, _canonList[canon]);
+    if(MotifLatticeVisit(g, _canonList[canon], 0, canon, &space, maxEntries, NULL, NULL)) {
+	_motifs[canon] = Realloc(_motifs[canon], _numMotifs[canon] * sizeof(MOTIF));
+	_motifTableEntries += _numMotifs[canon];
+    }
+    else {
+	Free(_motifs[canon]);
+	_motifs[canon] = NULL;
+	_numMotifs[canon] = -1;
+    }
+}
+
+// Print all the motifs under this graphlet. Note that this one actually outputs directly (see PutIndexLine), it does
+// ** not ** print into a buffer and return a char*.
+void PrintAllMotifs(TINY_GRAPH *g, int Gint, int GintOrdinal, GRAPH *G, unsigned Varray[])
+{
+    static TINY_GRAPH *walk;
+    char perm[MAX_K];
+    int i;
+#if PARANOID_ASSERTS
+    assert(g->n == _k);
+    assert(TinyGraphDFSConnected(g, 0));
+#endif
+    assert(_k>= 3 && _k <= 8);
+    assert(PERMS_CAN2NON);
+    if(!_motifs[GintOrdinal] && _numMotifs[GintOrdinal] == 0) MotifLatticeBuild(GintOrdinal);
+    memset(perm, 0, _k);
+    ExtractPerm(perm, Gint);
+    if(_numMotifs[GintOrdinal] < 0) { // too many to list
+	if(!walk) walk = TinyGraphAlloc(_k);
+	Int2TinyGraph(walk, _canonList[GintOrdinal]);
+	MotifLatticeVisit(walk, _canonList[GintOrdinal], 0, GintOrdinal, NULL, 0, perm, Varray);
+	return;
+    }
+    for(i=0; i<_numMotifs[GintOrdinal]; i++) PutMotif(_motifs[GintOrdinal] + i, perm, Varray);
 }
 
 Boolean ProcessGraphlet(GRAPH *G, SET *V, unsigned Varray[], const int k, TINY_GRAPH *g)
 {
-    Boolean processed = true;
     TinyGraphInducedFromGraph(g, G, Varray);
-    int Gint = TinyGraph2Int(g,k), GintOrdinal=_K[Gint], j;
+    return ProcessInducedGraphlet(G, V, Varray, k, g, TinyGraph2Int(g,k));
+}
+
+Boolean ProcessInducedGraphlet(GRAPH *G, SET *V, unsigned Varray[], const int k, TINY_GRAPH *g, int Gint)
+{
+    Boolean processed = true;
+    int GintOrdinal=_K[Gint], j;
 
 #if PARANOID_ASSERTS
     assert(0 <= GintOrdinal && GintOrdinal < _numCanon);
@@ -227,7 +727,7 @@ Boolean ProcessGraphlet(GRAPH *G, SET *V, unsigned Varray[], const int k, TINY_G
 #endif
 	if(NodeSetSeenRecently(G, Varray,k) ||
 	    (_sampleMethod == SAMPLE_INDEX && !SetIn(_windowRep_allowed_ambig_set, GintOrdinal))) processed=false;
-	else puts(PrintIndexEntry(Gint, GintOrdinal, Varray, g, k));
+	else PutIndexEntry(Gint, GintOrdinal, Varray, g, k);
 	break;
     case indexMotifs: case indexMotifOrbits:
 	if(NodeSetSeenRecently(G,Varray,k)) processed=false;
@@ -245,18 +745,19 @@ Boolean ProcessGraphlet(GRAPH *G, SET *V, unsigned Varray[], const int k, TINY_G
 #endif
 	if(NodeSetSeenRecently(G,Varray,k) ||
 	    (_sampleMethod == SAMPLE_INDEX && !SetIn(_windowRep_allowed_ambig_set, GintOrdinal))) processed=false;
-	else puts(PrintIndexOrbitsEntry(Gint, GintOrdinal, Varray, g, k));
+	else PutIndexOrbitsEntry(Gint, GintOrdinal, Varray, g, k);
 	break;
     case outputGDV:
-	for(j=0;j<k;j++) ++GDV(Varray[j], GintOrdinal);
+	for(j=0;j<k;j++) INC_GDV(Varray[j], GintOrdinal);
 	break;
     case outputODV:
+	if(_MCMC_EVERY_EDGE && _sampleMethod == SAMPLE_MCMC) break; // SampleGraphletMCMC counted it in _doubleOrbitDegreeVector
 	memset(perm, 0, _k);
 	ExtractPerm(perm, Gint);
 #if PERMS_CAN2NON
-	for(j=0;j<k;j++) ++ODV(Varray[(int)perm[j]], _orbitList[GintOrdinal][          j ]);
+	for(j=0;j<k;j++) INC_ODV(Varray[(int)perm[j]], _orbitList[GintOrdinal][          j ]);
 #else
-	for(j=0;j<k;j++) ++ODV(Varray[          j ], _orbitList[GintOrdinal][(int)perm[j]]);
+	for(j=0;j<k;j++) INC_ODV(Varray[          j ], _orbitList[GintOrdinal][(int)perm[j]]);
 #endif
 	break;
 
@@ -5,8 +5,26 @@
 
 // ProcessGraphlet returns true if the graphlet was processed, and false if it was removed due to being a duplicate
 Boolean ProcessGraphlet(GRAPH *G, SET *V, unsigned Varray[], const int k, TINY_GRAPH *g);
+// Same, but g already holds the graphlet induced by Varray, and Gint = TinyGraph2Int(g,k).
+Boolean ProcessInducedGraphlet(GRAPH *G, SET *V, unsigned Varray[], const int k, TINY_GRAPH *g, int Gint);
 Boolean NodeSetSeenRecently(GRAPH *G, unsigned Varray[], int k);
 
+// Index lines (-m{i|j|m|M}) don't go through stdio: they're assembled in a buffer of INDEX_OUTPUT_BYTES per process,
+// which is written to stdout whenever it fills up. So call FlushIndexOutput before writing anything else to stdout,
+// and before forking; and IndexOutputFinish before exiting. With ASYNC_INDEX_OUTPUT, a separate writer process does
+// the writing while the top-level process carries on; a forked child calls IndexOutputDetach to leave it alone.
+#define INDEX_OUTPUT_BYTES (1 << 20)
+#define ASYNC_INDEX_OUTPUT 1
+extern int _indexFormat; // 0 for text, else the binary layout (-m{i|m}{b|c}; see blant-index-format.h)
+void IndexOutputInit(GRAPH *G, long numSamples); // before the first index line; again if _supportNodeNames changes
+void PutIndexLine(const char *line); // one that's already formatted, newline included (text only)
+void FlushIndexOutput(void);
+void IndexOutputFinish(void);
+void IndexOutputDetach(void);
+
+extern Boolean _sparseDegreeVectors; // -m{g|o}s
+void PrintDegreeVectors(GRAPH *G, int k); // the -mg or -mo output, at the end
+
 
 // None of the "Print" routines here actually print anything; they put the string into a constant internal buff, and then
 // YOU must print it (immediately is best, since the buffer will be over-written the next time you call the function).
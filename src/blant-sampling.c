@@ -1,3 +1,4 @@
+#include <limits.h>
 #include "blant.h"
 #include "blant-sampling.h"
 #include "blant-utils.h"
@@ -6,16 +7,28 @@
 #include "queue.h"
 #include "multisets.h"
 #include "blant-output.h"
+#include "blant-cc.h"
 
 int _sampleMethod = -1;
 FILE *_sampleFile; // if _sampleMethod is SAMPLE_FROM_FILE
 char _sampleFileEOF;
 Boolean _MCMC_EVERY_EDGE = false; // Should MCMC restart at each edge
+int _lazyFrontierHubDegree = LAZY_FRONTIER_HUB_DEGREE;
 int _samplesPerEdge = 0;
 int _numSamples = 0;
 unsigned _MCMC_L;
 unsigned long int _acceptRejectTotalTries;
 
+// Pick an edge uniformly at random from connected component whichCC, returning its index into G->edgeList.
+// This is a single draw from the per-component edge index built in InitializeConnectedComponents, so it costs the
+// same no matter how small a share of G's edges the component has.
+int RandomComponentEdge(int whichCC)
+{
+    int first = _componentFirstEdge[whichCC], numEdges = _componentFirstEdge[whichCC+1] - first;
+    assert(numEdges > 0); // components with one node have zero probability of being chosen
+    return _componentEdge[first + (int)(numEdges * RandomUniform())];
+}
+
 // Update the most recent d-graphlet to a random neighbor of it
 int *MCMCGetNeighbor(int *Xcurrent, GRAPH *G)
 {
@@ -51,26 +64,95 @@ int *MCMCGetNeighbor(int *Xcurrent, GRAPH *G)
 	return Xcurrent;
 }
 
-// Crawls one step along the graph updating our sliding window
-void crawlOneStep(MULTISET *XLS, QUEUE *XLQ, int* X, GRAPH *G) {
-	int v, i;
-	for (i = 0; i < mcmc_d; i++) { // Remove oldest d graphlet from sliding window
-		v = QueueGet(XLQ).i;
-		MultisetDelete(XLS, v);
+MCMC_WINDOW *McmcWindowAlloc(int size)
+{
+    MCMC_WINDOW *W = Calloc(1, sizeof(MCMC_WINDOW));
+    int hashSize = 4;
+    assert(size > 0 && size < 256); // multiplicities are stored in unsigned chars
+    while(hashSize < 2*size) hashSize *= 2;
+    W->size = size;
+    W->hashMask = hashSize-1;
+    W->ring = Calloc(size + hashSize, sizeof(int)); // one allocation so it's all contiguous
+    W->key = W->ring + size;
+    W->mult = Calloc(hashSize, sizeof(unsigned char));
+    McmcWindowEmpty(W);
+    return W;
+}
+
+void McmcWindowFree(MCMC_WINDOW *W)
+{
+    free(W->ring);
+    free(W->mult);
+    free(W);
+}
+
+void McmcWindowEmpty(MCMC_WINDOW *W)
+{
+    int h;
+    W->front = W->count = W->support = 0;
+    for(h=0; h<=W->hashMask; h++) W->key[h] = -1;
+}
+
+#define McmcWindowHash(W,v) ((unsigned)(v)*2654435761U & (W)->hashMask) // Knuth's multiplicative hash
+
+// Return the slot of v in W's hash table, or if it's not there, the free slot where it would go.
+static int McmcWindowSlot(MCMC_WINDOW *W, int v)
+{
+    int h = McmcWindowHash(W,v);
+    while(W->key[h] != -1 && W->key[h] != v) h = (h+1) & W->hashMask;
+    return h;
+}
+
+// Append v to the window as its newest entry
+static void McmcWindowPut(MCMC_WINDOW *W, int v)
+{
+    assert(W->count < W->size);
+    W->ring[(W->front + W->count++) % W->size] = v;
+    int h = McmcWindowSlot(W, v);
+    if(W->key[h] == -1) { W->key[h] = v; W->mult[h] = 0; ++W->support; }
+    ++W->mult[h];
+}
+
+// Remove and return the oldest entry of the window
+static int McmcWindowGet(MCMC_WINDOW *W)
+{
+    assert(W->count > 0);
+    int v = W->ring[W->front], h = McmcWindowSlot(W, v), j;
+    W->front = (W->front + 1) % W->size;
+    --W->count;
+    assert(W->key[h] == v && W->mult[h] > 0);
+    if(--W->mult[h]) return v;
+    --W->support;
+    // Delete v from the hash table without leaving a tombstone: shift back any later entries of the probe sequence
+    // that could no longer be found with h empty (ie., whose home slot is not cyclically in (h,j]).
+    for(j = (h+1) & W->hashMask; W->key[j] != -1; j = (j+1) & W->hashMask)
+    {
+	int home = McmcWindowHash(W, W->key[j]);
+	if(((j - home) & W->hashMask) >= ((j - h) & W->hashMask))
+	{
+	    W->key[h] = W->key[j]; W->mult[h] = W->mult[j];
+	    h = j;
 	}
+    }
+    W->key[h] = -1;
+    return v;
+}
+
+// Crawls one step along the graph updating our sliding window
+void crawlOneStep(MCMC_WINDOW *XL, int* X, GRAPH *G) {
+	int i;
+	for (i = 0; i < mcmc_d; i++) // Remove oldest d graphlet from sliding window
+		McmcWindowGet(XL);
 	MCMCGetNeighbor(X, G); // Gets a neighbor graphlet of the most recent d vertices and add to sliding window
-	for (i = 0; i < mcmc_d; i++) {
-		MultisetAdd(XLS, X[i]);
-		QueuePut(XLQ, (foint) X[i]);
-	}
+	for (i = 0; i < mcmc_d; i++)
+		McmcWindowPut(XL, X[i]);
 }
 
-// Initialize a sliding window represented by a multiset and queue of vertices.
+// Initialize a sliding window of the last windowSize d-graphlets walked.
 // Sliding window is generated from a preselected edge from a predefined connected component and grown through edge walking.
-void initializeSlidingWindow(MULTISET *XLS, QUEUE *XLQ, int* X, GRAPH *G, int windowSize, int edge)
+void initializeSlidingWindow(MCMC_WINDOW *XL, int* X, GRAPH *G, int windowSize, int edge)
 {
-	MultisetEmpty(XLS);
-	QueueEmpty(XLQ);
+	McmcWindowEmpty(XL);
 
 	if (windowSize < 1) {
 		Fatal("Window Size must be at least 1");
@@ -82,26 +164,24 @@ void initializeSlidingWindow(MULTISET *XLS, QUEUE *XLQ, int* X, GRAPH *G, int wi
 	X[0] = G->edgeList[2 * edge];
 	X[1] = G->edgeList[2 * edge + 1];
 
-    MultisetAdd(XLS, X[0]); QueuePut(XLQ, (foint) X[0]);
-    MultisetAdd(XLS, X[1]); QueuePut(XLQ, (foint) X[1]);
+    McmcWindowPut(XL, X[0]);
+    McmcWindowPut(XL, X[1]);
 
 	// Add windowSize-1 d graphlets to our sliding window. The edge we added is the first d graphlet
 	int i, j;
 	for (i = 1; i < windowSize; i++) {
 		MCMCGetNeighbor(X, G); // After each call latest graphlet is in X array
-		for (j = 0; j < mcmc_d; j++) {
-			MultisetAdd(XLS, X[j]);
-			QueuePut(XLQ, (foint) X[j]);
-		}
+		for (j = 0; j < mcmc_d; j++)
+			McmcWindowPut(XL, X[j]);
 	}
 }
 
-// WalkLSteps fills XLS, XLQ (the sliding window) with L dgraphlets
-// Given an empty sliding window, XLQ, XLS, walk along the graph starting at a random edge
+// WalkLSteps fills XL (the sliding window) with L dgraphlets
+// Given an empty sliding window XL, walk along the graph starting at a random edge
 // growing our sliding window until we have L graphlets in it.
 // Then, we slide our window until it has k distinct vertices. That represents our initial sampling
 // when we start/restart.
-void WalkLSteps(MULTISET *XLS, QUEUE *XLQ, int* X, GRAPH *G, int k, int cc, int edge)
+void WalkLSteps(MCMC_WINDOW *XL, int* X, GRAPH *G, int k, int cc, int edge)
 {
 
 	//For now d must be equal to 2 because we start by picking a random edge
@@ -110,17 +190,17 @@ void WalkLSteps(MULTISET *XLS, QUEUE *XLQ, int* X, GRAPH *G, int k, int cc, int
 	}
 
 	if (edge < 0 && cc == -1) { // Pick a random edge from anywhere in the graph that has at least k nodes
-		do {
-		edge = G->numEdges * RandomUniform();
+		// CCs are sorted largest first, so the edges of those with at least k nodes are a prefix of _componentEdge.
+		int numBig = 0;
+		while(numBig < _numConnectedComponents && _componentSize[numBig] >= k) numBig++;
+		assert(numBig > 0);
+		edge = _componentEdge[(int)(_componentFirstEdge[numBig] * RandomUniform())];
 		X[0] = G->edgeList[2*edge];
-		} while(!(_componentSize[_whichComponent[G->edgeList[2*edge]]] < k));
 		X[1] = G->edgeList[2*edge+1];
 	}
 	else if (edge < 0) { // Pick a random edge from within a chosen connected component
-		do {
-		edge = G->numEdges * RandomUniform();
+		edge = RandomComponentEdge(cc);
 		X[0] = G->edgeList[2*edge];
-		} while(!SetIn(_componentSet[cc], X[0]));
 		X[1] = G->edgeList[2*edge+1];
 	}
 	// else start from the preselected edge
@@ -129,24 +209,136 @@ void WalkLSteps(MULTISET *XLS, QUEUE *XLQ, int* X, GRAPH *G, int k, int cc, int
 	assert(_componentSize[_whichComponent[X[0]]] >= k); // Assert we can fill the window with the prechosen edge.
 #endif
 
-	initializeSlidingWindow(XLS, XLQ, X, G, _MCMC_L, edge);
+	initializeSlidingWindow(XL, X, G, _MCMC_L, edge);
 
 	// Keep crawling until we have k distinct vertices
 	static int numTries = 0;
 	static int depth = 0;
-	while (MultisetSupport(XLS) < k) {
+	while (McmcWindowSupport(XL) < k) {
 	    if (numTries++ > MAX_TRIES) { // If we crawl 100 steps without k distinct vertices restart
 		assert(depth++ < MAX_TRIES); // If we restart 100 times in a row without success give up
-		WalkLSteps(XLS,XLQ,X,G,k,cc,edge); // try again
+		WalkLSteps(XL,X,G,k,cc,edge); // try again
 		depth = 0; // If we get passed the recursive calls and successfully find a k graphlet, reset our depth
 		numTries = 0; // And our number of attempts to crawl one step
 		return;
 	    }
-	    crawlOneStep(XLS, XLQ, X, G);
+	    crawlOneStep(XL, X, G);
 	}
 	numTries = 0;
 }
 
+// O(1) adjacency test when G carries its adjacency matrix (SPARSE==both), else scan the shorter neighbor list.
+#define FastAreConnected(G,u,v) ((G)->A ? SetIn((G)->A[u],(v)) : GraphAreConnected((G),(u),(v)))
+
+// Build, from scratch, the exact "outset" of the nodes in nodes[0..numNodes): the SET outSet and the list outbound[]
+// of every node adjacent to at least one of them that is not in V. Returns the length of outbound[].
+static int BuildOutset(GRAPH *G, SET *V, int *nodes, int numNodes, SET *outSet, int *outbound)
+{
+    int i, j, nOut = 0;
+    SetEmpty(outSet);
+    for(i=0; i<numNodes; i++) for(j=0; j < G->degree[nodes[i]]; j++)
+    {
+	int u = G->neighbor[nodes[i]][j];
+	if(!SetIn(V, u) && !SetIn(outSet, u))
+	    SetAdd(outSet, (outbound[nOut++] = u));
+    }
+    return nOut;
+}
+
+#if USE_LAZY_FRONTIER
+// A lazy frontier represents the nodes one step outside the graphlet-in-construction implicitly, as the concatenation
+// of the neighbor lists ("ranges") of the nodes added so far, rather than copying every neighbor into an outbound[]
+// array. That copy costs O(degree) per node added, which is ruinous when the graphlet touches a hub of degree 100,000.
+// Instead we pick a slot uniformly among all the ranges and reject it if it's in V, or if it's a duplicate: a node
+// adjacent to several members is only accepted from the *first* range it appears in. Thus every distinct frontier
+// node owns exactly one accepting slot, which gives precisely the distribution of the exact outbound[] array, at
+// O(k) expected cost per draw as long as rejections are rare.
+// The reservoir sampler also removes nodes from the frontier when it draws them, and they only come back if a range
+// added *later* contains them; so we remember when each node was drawn, and only look at ranges added after that.
+// The same goes for the starting edge, and for a member the reservoir evicts: it was never in the exact outbound[]
+// array while in V, so it only becomes eligible again from the ranges added after its eviction.
+// Since those draws make rejections common on sparse graphs, it stays exact until a hub joins (LAZY_FRONTIER_HUB_DEGREE).
+#define MAX_FRONTIER_RANGES (RESERVOIR_MULTIPLIER*MAX_K)
+#define MAX_FRONTIER_DRAWS (2*MAX_FRONTIER_RANGES+2) // every draw, every eviction, and the starting edge
+typedef struct _lazyFrontier {
+    int numRanges, node[MAX_FRONTIER_RANGES];
+    long cumDegree[MAX_FRONTIER_RANGES]; // cumDegree[i] = sum of the degrees of node[0..i]
+    SET *drawnSet; // NULL unless we're tracking draws; then drawn[i] was drawn when there were drawnAt[i] ranges.
+    int numDrawn, drawn[MAX_FRONTIER_DRAWS], drawnAt[MAX_FRONTIER_DRAWS];
+} LAZY_FRONTIER;
+
+static void LazyFrontierReset(LAZY_FRONTIER *F)
+{
+    F->numRanges = 0;
+    // SetEmpty is O(n/64) but SetDelete can cost O(n) each if it deletes the smallest element (eg., a low-numbered hub)
+    if(F->drawnSet && F->numDrawn) SetEmpty(F->drawnSet);
+    F->numDrawn = 0;
+}
+
+static void LazyFrontierAdd(LAZY_FRONTIER *F, GRAPH *G, int v)
+{
+    assert(F->numRanges < MAX_FRONTIER_RANGES);
+    F->node[F->numRanges] = v;
+    F->cumDegree[F->numRanges] = G->degree[v] + (F->numRanges ? F->cumDegree[F->numRanges-1] : 0);
+    F->numRanges++;
+}
+
+// the index of the first range in which u is eligible to be drawn
+static int LazyFrontierFirstEligible(LAZY_FRONTIER *F, int u)
+{
+    int i;
+    if(!F->drawnSet || !SetIn(F->drawnSet, u)) return 0;
+    for(i=F->numDrawn-1; i>=0; i--) if(F->drawn[i] == u) return F->drawnAt[i]; // most recent draw counts
+    assert(false);
+    return 0;
+}
+
+static void LazyFrontierMarkDrawn(LAZY_FRONTIER *F, int u)
+{
+    if(!F->drawnSet) return;
+    assert(F->numDrawn < MAX_FRONTIER_DRAWS);
+    SetAdd(F->drawnSet, u);
+    F->drawn[F->numDrawn] = u;
+    F->drawnAt[F->numDrawn++] = F->numRanges;
+}
+
+// Returns a node chosen uniformly at random from the frontier, or -1 after LAZY_FRONTIER_MAX_TRIES consecutive
+// rejections, in which case the caller should fall back to building the outset explicitly (which also correctly
+// handles the case of an empty frontier).
+static int LazyFrontierDraw(LAZY_FRONTIER *F, GRAPH *G, SET *V)
+{
+    int tries;
+    for(tries=0; tries < LAZY_FRONTIER_MAX_TRIES; tries++)
+    {
+	long slot = F->cumDegree[F->numRanges-1] * RandomUniform();
+	int lo = 0, hi = F->numRanges-1, i;
+	while(lo < hi) { // find the first range whose cumulative degree exceeds slot
+	    int mid = (lo+hi)/2;
+	    if(F->cumDegree[mid] <= slot) lo = mid+1; else hi = mid;
+	}
+	int owner = F->node[lo], u = G->neighbor[owner][slot - (F->cumDegree[lo] - G->degree[owner])];
+	if(SetIn(V, u) || (i = LazyFrontierFirstEligible(F, u)) > lo) continue;
+	for(; i<lo; i++) if(FastAreConnected(G, F->node[i], u)) break;
+	if(i == lo) return u; // lo is the first eligible range that contains u
+    }
+    return -1;
+}
+
+// Convert a lazy frontier into the exact outSet/outbound[] representation; returns the length of outbound[].
+static int LazyFrontierToOutset(LAZY_FRONTIER *F, GRAPH *G, SET *V, SET *outSet, int *outbound)
+{
+    int i, j, nOut = 0;
+    SetEmpty(outSet);
+    for(i=0; i<F->numRanges; i++) for(j=0; j < G->degree[F->node[i]]; j++)
+    {
+	int u = G->neighbor[F->node[i]][j];
+	if(!SetIn(V, u) && !SetIn(outSet, u) && LazyFrontierFirstEligible(F, u) <= i)
+	    SetAdd(outSet, (outbound[nOut++] = u));
+    }
+    return nOut;
+}
+#endif
+
 // Given the big graph G and an integer k, return a k-graphlet from G
 // in the form of a SET of nodes called V. When complete, |V| = k.
 // Caller is responsible for allocating the set V and its array Varray.
@@ -157,6 +349,8 @@ void WalkLSteps(MULTISET *XLS, QUEUE *XLQ, int* X, GRAPH *G, int k, int cc, int
 // new node (ie., edges that are not going back inside the graphlet).
 // So the "outset" is the set of edges going to nodes exactly distance
 // one from the set V, as V is being built.
+// With USE_LAZY_FRONTIER we start with the lazy representation above, and only build the exact outset if that
+// starts rejecting too many draws (typically because the neighborhood of V is small and dense).
 
 double SampleGraphletNodeBasedExpansion(SET *V, int *Varray, GRAPH *G, int k, int whichCC)
 {
@@ -166,48 +360,42 @@ double SampleGraphletNodeBasedExpansion(SET *V, int *Varray, GRAPH *G, int k, in
        outSet = SetAlloc(G->n);  // we won't bother to free this since it's static.
     else if(G->n > outSet->n)
 	SetResize(outSet, G->n);
-    else
-	SetEmpty(outSet);
     int v1, v2, i;
     int nOut = 0, outbound[G->n]; // vertices one step outside the boundary of V
     assert(V && V->n >= G->n);
     SetEmpty(V);
-    int edge;
-    do {
-	edge = G->numEdges * RandomUniform();
-	v1 = G->edgeList[2*edge];
-    } while(!SetIn(_componentSet[whichCC], v1));
+    int edge = RandomComponentEdge(whichCC);
+    v1 = G->edgeList[2*edge];
     v2 = G->edgeList[2*edge+1];
     SetAdd(V, v1); Varray[0] = v1;
     SetAdd(V, v2); Varray[1] = v2;
 
+    Boolean exact = !USE_LAZY_FRONTIER;
+#if USE_LAZY_FRONTIER
+    static LAZY_FRONTIER F;
+    LazyFrontierReset(&F);
+    LazyFrontierAdd(&F, G, v1);
+    LazyFrontierAdd(&F, G, v2);
+#endif
     // The below loops over neighbors can take a long time for large graphs with high mean degree. May be faster
     // with bit operations if we stored the adjacency matrix... which may be too big to store for big graphs. :-(
-    for(i=0; i < G->degree[v1]; i++)
+    if(exact) nOut = BuildOutset(G, V, Varray, 2, outSet, outbound);
+    for(i=2; i<k; i++)
     {
-	int nv1 =  G->neighbor[v1][i];
-	if(nv1 != v2)
+	int j;
+#if USE_LAZY_FRONTIER
+	if(!exact)
 	{
-#if PARANOID_ASSERTS
-	    assert(!SetIn(V, nv1)); // assertion to ensure we're in line with faye
-#endif
-	    SetAdd(outSet, (outbound[nOut++] = nv1));
+	    if((v1 = LazyFrontierDraw(&F, G, V)) >= 0)
+	    {
+		SetAdd(V, v1); Varray[i] = v1;
+		LazyFrontierAdd(&F, G, v1);
+		continue;
+	    }
+	    nOut = BuildOutset(G, V, Varray, i, outSet, outbound); // too many rejections; do it the slow way
+	    exact = true;
 	}
-    }
-    for(i=0; i < G->degree[v2]; i++)
-    {
-	int nv2 =  G->neighbor[v2][i];
-	if(nv2 != v1 && !SetIn(outSet, nv2))
-	{
-#if PARANOID_ASSERTS
-	    assert(!SetIn(V, nv2)); // assertion to ensure we're in line with faye
 #endif
-	    SetAdd(outSet, (outbound[nOut++] = nv2));
-	}
-    }
-    for(i=2; i<k; i++)
-    {
-	int j;
 	if(nOut == 0) // the graphlet has saturated it's connected component
 	{
 #if PARANOID_ASSERTS
@@ -251,7 +439,7 @@ double SampleGraphletNodeBasedExpansion(SET *V, int *Varray, GRAPH *G, int k, in
     assert(i==k);
 #if PARANOID_ASSERTS
     assert(SetCardinality(V) == k);
-    assert(nOut == SetCardinality(outSet));
+    assert(!exact || nOut == SetCardinality(outSet));
 #endif
     return 1.0;
 }
@@ -277,11 +465,8 @@ double SampleGraphletFaye(SET *V, int *Varray, GRAPH *G, int k, int whichCC)
     int nOut = 0, outbound[G->n]; // vertices one step outside the boundary of V
     assert(V && V->n >= G->n);
     SetEmpty(V);
-    int edge;
-    do {
-	edge = G->numEdges * RandomUniform();
-	v1 = G->edgeList[2*edge];
-    } while(!SetIn(_componentSet[whichCC], v1));
+    int edge = RandomComponentEdge(whichCC);
+    v1 = G->edgeList[2*edge];
     v2 = G->edgeList[2*edge+1];
     SetAdd(V, v1); Varray[0] = v1;
     SetAdd(V, v2); Varray[1] = v2;
@@ -444,16 +629,127 @@ double SampleGraphletFromFile(SET *V, int *Varray, GRAPH *G, int k)
 ** is blinding speed at graphlet sampling, eg for building a graphlet database
 ** index, then this is the preferred method.
 */
+#if EBE_EXACT_OUTDEGREE
+// Subtract from ext[j] each edge between Varray[m] and Varray[j], j<m; return how many there were.
+static int EbeInternalEdges(GRAPH *G, SET *V, int *Varray, int m, int ext[])
+{
+    int j, l, adjacent = 0, v = Varray[m];
+    if(G->degree[v] <= EBE_SCAN_DEGREE) { // a short neighbor list and V are likely in cache, unlike G->A
+	for(l=0; l<G->degree[v]; l++) if(SetIn(V, G->neighbor[v][l])) {
+	    for(j=0; j<m && Varray[j] != G->neighbor[v][l]; j++)
+		;
+	    if(j<m) { --ext[j]; ++adjacent; }
+	}
+    }
+    else for(j=0; j<m; j++) if(FastAreConnected(G, v, Varray[j])) { --ext[j]; ++adjacent; }
+    return adjacent;
+}
+
+/*
+** The same distribution, without the unbounded retries. Draw an edge as above; usually it leaves V and we're done.
+** If EBE_EXACT_AFTER_REJECTIONS draws in this graphlet haven't (eg. we're inside a small dense cluster of low-degree
+** nodes), switch to keeping the *exact* count ext[j] of edges from Varray[j] to nodes outside V for the rest of the
+** graphlet (O(k) per node added), pick j in proportion to it, and then a random neighbor of Varray[j]. That neighbor
+** can still be in V, but since Varray[j] has at most k-1 neighbors in V that happens with probability at most
+** (k-1)/degree; when it does we walk the neighbor list to the r'th neighbor outside V instead, where r is uniform on
+** [0,ext[j]). Either way each step's edge is uniform among those leaving V, as before, but there's no MAX_TRIES,
+** no n-bit "internal" set to clear per sample, and no restart unless the whole connected component has been swallowed.
+** (With k <= 8, a linear scan of the k counts beats any alias table or Fenwick tree.)
+*/
+static double EdgeExpansionExactOutdegree(SET *V, int *Varray, GRAPH *G, int k, int whichCC)
+{
+    int ext[MAX_K], i, j, vCount = 2, edge = RandomComponentEdge(whichCC);
+    Boolean exact = false; // whether ext[] is valid yet
+    int rejections = 0;
+    long total; // sum of ext[], or of the degrees of V while !exact
+    SetEmpty(V);
+    Varray[0] = G->edgeList[2*edge];
+    Varray[1] = G->edgeList[2*edge+1];
+    SetAdd(V, Varray[0]);
+    SetAdd(V, Varray[1]);
+    total = G->degree[Varray[0]] + G->degree[Varray[1]];
+
+    while(vCount < k)
+    {
+	int u, newNode = -1;
+	long r;
+	if(!exact) {
+	    r = total * RandomUniform();
+	    for(i=0; r >= G->degree[Varray[i]]; i++) // whose edge is it?
+		r -= G->degree[Varray[i]];
+	    newNode = G->neighbor[Varray[i]][r];
+	    if(SetIn(V, newNode)) {
+		if(++rejections < EBE_EXACT_AFTER_REJECTIONS)
+		    continue;
+		for(j=0; j<vCount; j++) {
+		    ext[j] = G->degree[Varray[j]];
+		    ext[j] -= EbeInternalEdges(G, V, Varray, j, ext);
+		}
+		for(j=0, total=0; j<vCount; j++)
+		    total += ext[j];
+		exact = true;
+	    }
+	}
+	if(exact) {
+	    if(total == 0) // the graphlet has swallowed its connected component
+	    {
+#if ALLOW_DISCONNECTED_GRAPHLETS
+		do newNode = G->n*RandomUniform();
+		while(SetIn(V, newNode)); // must terminate since k <= G->n
+#else
+		static int depth;
+		depth++;
+		assert(depth < MAX_TRIES);
+		EdgeExpansionExactOutdegree(V, Varray, G, k, whichCC);
+		depth--;
+		return 1.0;
+#endif
+	    }
+	    else
+	    {
+		r = total * RandomUniform();
+		for(i=0; r >= ext[i]; i++)
+		    r -= ext[i];
+		u = Varray[i];
+		newNode = G->neighbor[u][(int)(G->degree[u] * RandomUniform())];
+		if(SetIn(V, newNode)) // SetIn is a macro, so no side effects in its arguments
+		    for(j=0; ; j++) if(!SetIn(V, G->neighbor[u][j]) && r-- == 0) { newNode = G->neighbor[u][j]; break; }
+	    }
+	}
+	SetAdd(V, newNode);
+	Varray[vCount] = newNode;
+	if(exact) {
+	    ext[vCount] = G->degree[newNode];
+	    int adjacent = EbeInternalEdges(G, V, Varray, vCount, ext);
+	    ext[vCount] -= adjacent;
+	    total += ext[vCount] - adjacent;
+	}
+	else total += G->degree[newNode];
+	++vCount;
+#if PARANOID_ASSERTS
+	assert(SetCardinality(V) == vCount);
+	if(exact) {
+	    long sum = 0;
+	    for(j=0; j<vCount; j++) { assert(ext[j] >= 0); sum += ext[j]; }
+	    assert(sum == total);
+	}
+#endif
+    }
+    return 1.0;
+}
+#endif
+
 double SampleGraphletEdgeBasedExpansion(SET *V, int *Varray, GRAPH *G, int k, int whichCC)
 {
+#if EBE_EXACT_OUTDEGREE
+    return EdgeExpansionExactOutdegree(V, Varray, G, k, whichCC);
+#else
     int edge, v1, v2;
     assert(V && V->n >= G->n);
     SetEmpty(V);
     int nOut = 0;
-    do {
-	edge = G->numEdges * RandomUniform();
-	v1 = G->edgeList[2*edge];
-    } while(!SetIn(_componentSet[whichCC], v1));
+    edge = RandomComponentEdge(whichCC);
+    v1 = G->edgeList[2*edge];
     v2 = G->edgeList[2*edge+1];
     SetAdd(V, v1); Varray[0] = v1;
     SetAdd(V, v2); Varray[1] = v2;
@@ -556,6 +852,21 @@ double SampleGraphletEdgeBasedExpansion(SET *V, int *Varray, GRAPH *G, int k, in
     assert(vCount == k);
 #endif
     return 1.0;
+#endif
+}
+
+// Whether the k nodes whose adjacency rows (bitmasks over 0..k-1) are adj[] induce a connected graph.
+static Boolean BitmaskConnected(const unsigned adj[], int k)
+{
+    unsigned all = (1U << k) - 1, reached = 1, frontier = 1;
+    int i;
+    while(frontier && reached != all) {
+	unsigned next = 0;
+	for(i=0; i<k; i++) if(frontier & (1U << i)) next |= adj[i];
+	frontier = next & ~reached;
+	reached |= next;
+    }
+    return reached == all;
 }
 
 // From the paper: ``Sampling Connected Induced Subgraphs Uniformly at Random''
@@ -576,75 +887,96 @@ double SampleGraphletLuBressanReservoir(SET *V, int *Varray, GRAPH *G, int k, in
        outSet = SetAlloc(G->n);  // we won't bother to free this since it's static.
     else if(G->n > outSet->n)
 	SetResize(outSet, G->n);
-    else
-	SetEmpty(outSet);
     int v1, v2, i;
     int nOut = 0, outbound[G->n]; // vertices one step outside the boundary of V
     assert(V && V->n >= G->n);
     SetEmpty(V);
-    int edge;
-    do {
-	edge = G->numEdges * RandomUniform();
-	v1 = G->edgeList[2*edge];
-    } while(!SetIn(_componentSet[whichCC], v1));
+    int edge = RandomComponentEdge(whichCC);
+    v1 = G->edgeList[2*edge];
     v2 = G->edgeList[2*edge+1];
     SetAdd(V, v1); Varray[0] = v1;
     SetAdd(V, v2); Varray[1] = v2;
 
+    Boolean exact = true;
+#if USE_LAZY_FRONTIER
+    static LAZY_FRONTIER F; // always maintained, so that we can switch to lazy mode at any time for free
+    if(!F.drawnSet) F.drawnSet = SetAlloc(G->n); // candidates are drawn *without* replacement
+    else if(G->n > F.drawnSet->n) SetResize(F.drawnSet, G->n);
+    LazyFrontierReset(&F);
+    LazyFrontierAdd(&F, G, v1);
+    LazyFrontierAdd(&F, G, v2);
+    LazyFrontierMarkDrawn(&F, v1);
+    LazyFrontierMarkDrawn(&F, v2);
+    exact = (G->degree[v1] < _lazyFrontierHubDegree && G->degree[v2] < _lazyFrontierHubDegree);
+#endif
     // The below loops over neighbors can take a long time for large graphs with high mean degree. May be faster
     // with bit operations if we stored the adjacency matrix... which may be too big to store for big graphs. :-(
-    for(i=0; i < G->degree[v1]; i++)
-    {
-	int nv1 =  G->neighbor[v1][i];
-	if(nv1 != v2) SetAdd(outSet, (outbound[nOut++] = nv1));
-    }
-    for(i=0; i < G->degree[v2]; i++)
-    {
-	int nv2 =  G->neighbor[v2][i];
-	if(nv2 != v1 && !SetIn(outSet, nv2)) SetAdd(outSet, (outbound[nOut++] = nv2));
-    }
+    if(exact) nOut = BuildOutset(G, V, Varray, 2, outSet, outbound);
     i=2;
+    unsigned adj[MAX_K]; // in the reservoir phase: the induced graph on Varray, as a bitmask row per member
+    Boolean haveAdj = false;
 
     // while(i<k || nOut > 0) // always do the loop at least k times, but i>=k is the reservoir phase.
     while(i < RESERVOIR_MULTIPLIER*k) // value of 8 seems to work best from empirical studies.
     {
 	int candidate;
-	if(nOut ==0) // the graphlet has saturated its connected component before getting to k, start elsewhere
+#if USE_LAZY_FRONTIER
+	if(!exact)
 	{
-#if ALLOW_DISCONNECTED_GRAPHLETS
-	    if(i < k)
+	    if((v1 = LazyFrontierDraw(&F, G, V)) >= 0)
+		LazyFrontierMarkDrawn(&F, v1);
+	    else { // too many rejections; do it the slow way
+		nOut = LazyFrontierToOutset(&F, G, V, outSet, outbound);
+		exact = true;
+	    }
+	}
+#endif
+	if(exact)
+	{
+	    if(nOut ==0) // the graphlet has saturated its connected component before getting to k, start elsewhere
 	    {
-		int tries=0;
-		while(SetIn(V, (v1 = G->n*RandomUniform())))
-		    assert(tries++<MAX_TRIES); // graph is too disconnected
-		outbound[nOut++] = v1; // recall that nOut was 0 to enter this block, so now it's 1
-		candidate = 0; // representing v1 as the 0'th entry in the outbound array
+#if ALLOW_DISCONNECTED_GRAPHLETS
+		if(i < k)
+		{
+		    int tries=0;
+		    while(SetIn(V, (v1 = G->n*RandomUniform())))
+			assert(tries++<MAX_TRIES); // graph is too disconnected
+		    outbound[nOut++] = v1; // recall that nOut was 0 to enter this block, so now it's 1
+		    candidate = 0; // representing v1 as the 0'th entry in the outbound array
+		}
+		else
+		    assert(i==k); // we're done because i >= k and nOut == 0... but we shouldn't get here.
+#else
+		static int depth;
+		depth++;
+		assert(depth < MAX_TRIES); // graph is too disconnected
+		SampleGraphletLuBressanReservoir(V, Varray, G, k, whichCC);
+		depth--;
+		return 1.0;
+#endif
 	    }
 	    else
-		assert(i==k); // we're done because i >= k and nOut == 0... but we shouldn't get here.
-#else
-	    static int depth;
-	    depth++;
-	    assert(depth < MAX_TRIES); // graph is too disconnected
-	    SampleGraphletLuBressanReservoir(V, Varray, G, k, whichCC);
-	    depth--;
-	    return 1.0;
+	    {
+		candidate = nOut * RandomUniform();
+		v1 = outbound[candidate];
+	    }
+	    assert(v1 == outbound[candidate]);
+	    SetDelete(outSet, v1);
+	    outbound[candidate] = outbound[--nOut];// nuke v1 by moving the last one to its place
+#if USE_LAZY_FRONTIER
+	    LazyFrontierMarkDrawn(&F, v1);
 #endif
 	}
-	else
-	{
-	    candidate = nOut * RandomUniform();
-	    v1 = outbound[candidate];
-	}
-	assert(v1 == outbound[candidate]);
-	SetDelete(outSet, v1);
-	outbound[candidate] = outbound[--nOut];// nuke v1 by moving the last one to its place
 	if(i < k)
 	{
 	    Varray[i] = v1;
 	    SetAdd(V, v1);
 	    int j;
-	    for(j=0; j<G->degree[v1];j++) // another loop over neighbors that may take a long time...
+#if USE_LAZY_FRONTIER
+	    LazyFrontierAdd(&F, G, v1);
+	    if(G->degree[v1] >= _lazyFrontierHubDegree) exact = false;
+#endif
+	    if(exact) for(j=0; j<G->degree[v1];j++) // another loop over neighbors that may take a long time...
 	    {
 		v2 = G->neighbor[v1][j];
 		if(!SetIn(outSet, v2) && !SetIn(V, v2))
@@ -656,33 +988,33 @@ double SampleGraphletLuBressanReservoir(SET *V, int *Varray, GRAPH *G, int k, in
 	    double reservoir_alpha = RandomUniform();
 	    if(reservoir_alpha < k/(double)i)
 	    {
-		static TINY_GRAPH *T;
-		if(!T) T = TinyGraphAlloc(k);
-		static int graphetteArray[MAX_K], distArray[MAX_K];
-#if PARANOID_ASSERTS
-		// ensure it's connected before we do the replacement
-		TinyGraphEdgesAllDelete(T);
-		TinyGraphInducedFromGraph(T, G, Varray);
-#if 0
-		printf("NRN = %d\n", NumReachableNodes(T, 0));
-		printf("BFS = %d\n", TinyGraphBFS(T, 0, k, graphetteArray, distArray));
-#endif
-		assert(NumReachableNodes(T, 0) == TinyGraphBFS(T, 0, k, graphetteArray, distArray));
-		assert(NumReachableNodes(T, 0) == k);
-#endif
-		int memberToDelete = k*RandomUniform();
-		v2 = Varray[memberToDelete]; // remember the node delated from V in case we need to revert
-		Varray[memberToDelete] = v1; // v1 is the outbound candidate.
-		TinyGraphEdgesAllDelete(T);
-		TinyGraphInducedFromGraph(T, G, Varray);
+		// Only the row of the swapped-in node v1 changes, so that's all we recompute before checking connectivity.
+		int j, l, memberToDelete = k*RandomUniform();
+		unsigned row = 0, newAdj[MAX_K];
+		if(!haveAdj) {
+		    for(j=0; j<k; j++) adj[j] = 0;
+		    for(j=0; j<k; j++) for(l=j+1; l<k; l++)
+			if(FastAreConnected(G, Varray[j], Varray[l])) { adj[j] |= 1U << l; adj[l] |= 1U << j; }
+		    haveAdj = true;
+		}
 #if PARANOID_ASSERTS
-		assert(NumReachableNodes(T,0) == TinyGraphBFS(T, 0, k, graphetteArray, distArray));
+		assert(BitmaskConnected(adj, k)); // ensure it's connected before we do the replacement
 #endif
-		if(NumReachableNodes(T, 0) < k)
-		    Varray[memberToDelete] = v2; // revert the change because the graph is not connected
-		else // add the new guy and delete the old
+		for(j=0; j<k; j++) if(j != memberToDelete && FastAreConnected(G, Varray[j], v1)) row |= 1U << j;
+		for(j=0; j<k; j++) newAdj[j] = (adj[j] & ~(1U << memberToDelete)) | (((row >> j) & 1) << memberToDelete);
+		newAdj[memberToDelete] = row;
+		if(row && BitmaskConnected(newAdj, k)) // else leave V alone, since the swap would disconnect it
 		{
+		    v2 = Varray[memberToDelete];
+		    Varray[memberToDelete] = v1; // v1 is the outbound candidate.
+		    memcpy(adj, newAdj, k * sizeof(adj[0]));
 #if PARANOID_ASSERTS
+		    static TINY_GRAPH *T;
+		    static int graphetteArray[MAX_K], distArray[MAX_K];
+		    if(!T) T = TinyGraphAlloc(k);
+		    TinyGraphEdgesAllDelete(T);
+		    TinyGraphInducedFromGraph(T, G, Varray);
+		    assert(TinyGraphBFS(T, 0, k, graphetteArray, distArray) == k);
 		    assert(SetCardinality(V) == k);
 #endif
 		    SetDelete(V, v2);
@@ -690,8 +1022,12 @@ double SampleGraphletLuBressanReservoir(SET *V, int *Varray, GRAPH *G, int k, in
 #if PARANOID_ASSERTS
 		    assert(SetCardinality(V) == k);
 #endif
-		    int j;
-		    for(j=0; j<G->degree[v1];j++) // another loop over neighbors that may take a long time...
+#if USE_LAZY_FRONTIER
+		    LazyFrontierMarkDrawn(&F, v2); // evicted: eligible again only from the ranges added from now on
+		    LazyFrontierAdd(&F, G, v1);
+		    if(G->degree[v1] >= _lazyFrontierHubDegree) exact = false;
+#endif
+		    if(exact) for(j=0; j<G->degree[v1];j++) // another loop over neighbors that may take a long time...
 		    {
 			v2 = G->neighbor[v1][j];
 			if(!SetIn(outSet, v2) && !SetIn(V, v2))
@@ -709,39 +1045,57 @@ double SampleGraphletLuBressanReservoir(SET *V, int *Varray, GRAPH *G, int k, in
 }
 
 /* SampleGraphletMCMC first starts with an edge in Walk L steps.
-   It then walks along L = k-1 edges with MCMCGetNeighbor until it fills XLQ and XLS with L edges(their vertices are stored).
-   XLQ and XLS always hold 2L vertices. They represent a window of the last L edges walked. If that window contains k
+   It then walks along L = k-1 edges with MCMCGetNeighbor until it fills the window XL with L edges(their vertices are stored).
+   XL always holds 2L vertices. They represent a window of the last L edges walked. If that window contains k
    distinct vertices, a graphlet is returned.
    This random walk predictably overcounts graphlets based on the alpha value and multipler.
    The alpha value is precomputed per graphlet type and the multiplier is based on the degree of the graphlets inside of it.
    After the algorithm is run the frequencies are normalized into concentrations.
 */
 
+// Prefetch what chain X will touch on its next MCMCGetNeighbor. Neighbor lists are reached through G->neighbor[u],
+// which may itself miss, so stage 0 fetches the pointers and degrees, and stage 1 (a turn later) the lists themselves.
+static void MCMCPrefetchChain(int *X, GRAPH *G, int stage)
+{
+    int i;
+    for(i=0; i<mcmc_d; i++)
+    {
+	if(stage == 0) { Prefetch(&G->degree[X[i]]); Prefetch(&G->neighbor[X[i]]); }
+	else Prefetch(G->neighbor[X[i]]);
+    }
+}
+
 // foundGraphletCount is the expected count of the found graphlet (multiplier/_alphaList[GintOrdinal]), which needs to be returned (but must be a parameter since there's already a return value on the function)
+// We run MCMC_CHAINS independent chains, taking one step of one chain per call, round-robin. Since every sample is
+// already weighted by its own overcount, the chains' contributions simply add into the same concentrations/ODVs.
 double SampleGraphletMCMC(SET *V, int *Varray, GRAPH *G, int k, int whichCC) {
-	static Boolean setup = false;
+	static Boolean setup[MCMC_CHAINS];
 	static int currSamples = 0; // Counts how many samples weve done at the current starting point
 	static int currEdge = 0; // Current edge we are starting at for uniform sampling
-	static MULTISET *XLS = NULL; // A multiset holding L dgraphlets as separate vertex integers
-	static QUEUE *XLQ = NULL; // A queue holding L dgraphlets as separate vertex integers
-	static int Xcurrent[mcmc_d]; // holds the most recently walked d graphlet as an invariant
+	static MCMC_WINDOW *chainXL[MCMC_CHAINS]; // The sliding window of the last L dgraphlets, as separate vertex integers
+	static int chainX[MCMC_CHAINS][mcmc_d]; // holds the most recently walked d graphlet as an invariant
 	static TINY_GRAPH *g = NULL; // Tinygraph for computing overcounting;
-	if (!XLQ || !XLS || !g) {
+	static int chain = 0; // which chain takes a step this time
+	const int numChains = (_MCMC_EVERY_EDGE || G->numEdges < MCMC_CHAINS_MIN_EDGES) ? 1 : MCMC_CHAINS;
+	if (!g) {
 		//NON REENTRANT CODE
-		XLQ = QueueAlloc(k*mcmc_d);
-		XLS = MultisetAlloc(G->n);
+		int c;
+		for(c=0; c<numChains; c++)
+		    chainXL[c] = McmcWindowAlloc(mcmc_d*_MCMC_L);
 		g = TinyGraphAlloc(k);
 	}
+	MCMC_WINDOW *XL = chainXL[chain];
+	int *Xcurrent = chainX[chain];
 
 	// The first time we run this, or when we restart. We want to find our initial L d graphlets.
-	if (!setup && !_MCMC_EVERY_EDGE) {
-		setup = true;
-		WalkLSteps(XLS, XLQ, Xcurrent, G, k, whichCC, -1);
+	if (!setup[chain] && !_MCMC_EVERY_EDGE) {
+		setup[chain] = true;
+		WalkLSteps(XL, Xcurrent, G, k, whichCC, -1);
 	}
-	else if (_MCMC_EVERY_EDGE && (!setup || currSamples >= _samplesPerEdge))
+	else if (_MCMC_EVERY_EDGE && (!setup[chain] || currSamples >= _samplesPerEdge))
 	{
-		setup = true;
-		WalkLSteps(XLS, XLQ, Xcurrent, G, k, whichCC, currEdge);
+		setup[chain] = true;
+		WalkLSteps(XL, Xcurrent, G, k, whichCC, currEdge);
 		do {
 			currEdge++;
 		} while (_componentSize[_whichComponent[G->edgeList[2*currEdge]]] < k);
@@ -750,35 +1104,40 @@ double SampleGraphletMCMC(SET *V, int *Varray, GRAPH *G, int k, int whichCC) {
 	else {
 		// Keep crawling until we have k distinct vertices(can sample a graphlet). Crawl at least once
 		do  {
-			crawlOneStep(XLS, XLQ, Xcurrent, G);
-		} while (MultisetSupport(XLS) != k);
+			crawlOneStep(XL, Xcurrent, G);
+		} while (McmcWindowSupport(XL) != k);
 		currSamples++;
 	}
+	if(numChains > 1) { // this chain is done walking; start fetching for the next two
+	    if(setup[(chain+1) % numChains]) MCMCPrefetchChain(chainX[(chain+1) % numChains], G, 1);
+	    if(setup[(chain+2) % numChains]) MCMCPrefetchChain(chainX[(chain+2) % numChains], G, 0);
+	}
+	chain = (chain+1) % numChains;
 #if PARANOID_ASSERTS
-		assert(MultisetSupport(XLS) == k); // very paranoid
-		assert(QueueSize(XLQ) == 2 *_MCMC_L); // very paranoid
+		assert(McmcWindowSupport(XL) == k); // very paranoid
+		assert(McmcWindowCount(XL) == 2 *_MCMC_L); // very paranoid
 #endif
 
-	/*
-	Our sliding window now contains k distinct nodes. Fill the set V and array Varray with them
-	The multiplier is a shorthand for d graphlet degree product, It is the product of the degrees
-	of all the graphlets in the sliding window except the first and last.
-	The degree of a graphlet is the sum of its outgoing edges.
-	The alpha value is the number of ways to do a d-walk over the graphlet
-	*/
 	int node, numNodes = 0, i, j, graphletDegree;
 	double multiplier = 1;
 	SetEmpty(V);
 
+	for (i = 0; i < _MCMC_L*mcmc_d; i++) {
+		node = McmcWindowEntry(XL, i);
+		if (!SetIn(V, node)) {
+			Varray[numNodes++] = node;
+			SetAdd(V, node);
+		}
+	}
+	assert(numNodes == k); // Ensure we are returning k nodes
+	TinyGraphInducedFromGraph(g, G, Varray);
+	int Gint = TinyGraph2Int(g, k);
+	Prefetch(&_K[Gint]); // the canon map is huge for big k; let this miss overlap with the multiplier computation
+
 	for (i = 0; i < _MCMC_L; i++) {
 		graphletDegree = -2; // The edge between the vertices in the graphlet isn't included and is double counted
 		for (j = 0; j < mcmc_d; j++) {
-			node = (XLQ->queue[(XLQ->front + (mcmc_d*i)+j) % XLQ->maxSize]).i;
-			if (!SetIn(V, node)) {
-				Varray[numNodes++] = node;
-				SetAdd(V, node);
-			}
-
+			node = McmcWindowEntry(XL, mcmc_d*i+j);
 			graphletDegree += G->degree[node];
 		}
 #if PARANOID_ASSERTS
@@ -791,11 +1150,8 @@ double SampleGraphletMCMC(SET *V, int *Varray, GRAPH *G, int k, int whichCC) {
 		}
 		assert(multiplier > 0.0);
 	}
-	TinyGraphInducedFromGraph(g, G, Varray);
-	int Gint = TinyGraph2Int(g, k);
 	int GintOrdinal = _K[Gint];
 
-	assert(numNodes == k); // Ensure we are returning k nodes
 	double count = 1.0;
 	if (_MCMC_L == 2) { // If _MCMC_L == 2, k = 3 and we can use the simplified overcounting formula.
 	    // The over counting ratio is the alpha value only.
@@ -805,11 +1161,13 @@ double SampleGraphletMCMC(SET *V, int *Varray, GRAPH *G, int k, int whichCC) {
 	    count = (double)multiplier/((double)_alphaList[GintOrdinal]);
 	}
 	if (_outputMode == outputODV) {
-	    char perm[k];
-	    memset(perm, 0, k);
-	    ExtractPerm(perm, Gint);
-	    for (j = 0; j < k; j++) {
-		_doubleOrbitDegreeVector[_orbitList[GintOrdinal][j]][Varray[(int)perm[j]]] += count;
+	    if (_MCMC_EVERY_EDGE) { // otherwise the integer ODV is used, and ProcessGraphlet counts it
+		char perm[k];
+		memset(perm, 0, k);
+		ExtractPerm(perm, Gint);
+		for (j = 0; j < k; j++) {
+		    _doubleOrbitDegreeVector[_orbitList[GintOrdinal][j]][Varray[(int)perm[j]]] += count;
+		}
 	    }
 	} else {
 	    if(count < 0) {
@@ -821,8 +1179,150 @@ double SampleGraphletMCMC(SET *V, int *Varray, GRAPH *G, int k, int whichCC) {
 	return count; // return the expected overcount
 }
 
-double SampleGraphletLuBressan_MCMC_MHS_without_Ooze(SET *V, int *Varray, GRAPH *G, int k) { return 1.0; } // slower
-double SampleGraphletLuBressan_MCMC_MHS_with_Ooze(SET *V, int *Varray, GRAPH *G, int k) { return 1.0; } // faster!
+/*
+** Lu & Bressan's Metropolis-Hastings samplers (MHS). The "state graph" has a node for each connected induced
+** k-subgraph S of G, with S and S' adjacent when S' = S - u + w for some u in S and w outside it. A walk on it whose
+** moves are accepted by the Metropolis-Hastings rule has the *uniform* distribution over the connected k-subgraphs
+** (of a component) as its stationary distribution, so its states can be counted directly, with none of SAMPLE_MCMC's
+** alpha tables or overcount weights. Each component gets its own walk, started by NBE and then burned in.
+**    without Ooze: propose a neighbor S' of S in the state graph uniformly at random, and accept it with probability
+**	min(1, deg(S)/deg(S')). Each step costs two StateDegree computations, O(k*deg) each.
+**    with Ooze: let S ooze along G's edges instead: drop a random u from S, and add a random neighbor w of a random
+**	remaining node. The chance of proposing S' from S, and of proposing S back from S', take only O(k^2) to compute,
+**	so each step costs O(k^2) rather than O(k*deg); their ratio replaces the degree ratio in the acceptance test.
+*/
+#define MHS_BURN_IN 1000 // steps each walk takes before its states are used as samples
+#define MHS_IN_S (1 << MAX_K) // in _mhsMark
+
+typedef struct { Boolean started; int S[MAX_K]; long degree; } MHS_WALK;
+static MHS_WALK *_mhsWalk; // one per connected component
+static int *_mhsMark; // per node of G, zero between calls: MHS_IN_S if it's in S, else bit i set if it's adjacent to S[i]
+static int *_mhsOut, _mhsOutSize; // the nodes outside S with a nonzero _mhsMark
+
+// The connected components of S - S[u], as bitmasks of positions in S, given S's adjacency as bitmasks.
+static int MhsComponentsWithout(const unsigned adj[], int k, int u, unsigned comp[])
+{
+    unsigned remaining = ((1U << k) - 1) & ~(1U << u);
+    int i, numComp = 0;
+    while(remaining) {
+	unsigned reached = remaining & -remaining, prev = 0;
+	while(reached != prev) {
+	    prev = reached;
+	    for(i=0; i<k; i++) if(prev & (1U << i)) reached |= adj[i] & remaining;
+	}
+	comp[numComp++] = reached;
+	remaining &= ~reached;
+    }
+    return numComp;
+}
+
+static void MhsAdjacency(GRAPH *G, const int S[], int k, unsigned adj[])
+{
+    int i, j;
+    for(i=0; i<k; i++) adj[i] = 0;
+    for(i=0; i<k; i++) for(j=i+1; j<k; j++) if(FastAreConnected(G, S[i], S[j])) { adj[i] |= 1U << j; adj[j] |= 1U << i; }
+}
+
+// Whether S - S[u] + w is connected, where w is adjacent to the positions in attach and comp[] are S - S[u]'s components.
+static Boolean MhsSwapConnected(unsigned attach, unsigned comp[], int numComp)
+{
+    int c;
+    for(c=0; c<numComp; c++) if(!(attach & comp[c])) return false;
+    return true;
+}
+
+// The degree of S in the state graph: the number of pairs (u in S, w outside S) for which S - u + w is connected. We
+// find each outside neighbor w of S along with the positions it's adjacent to, and count how many w share each such
+// pattern, so it's O(k*deg) plus O(k) per distinct pattern. If pick >= 0, also return the pick'th such pair.
+static long StateDegree(GRAPH *G, const int S[], int k, long pick, int *uPicked, int *wPicked)
+{
+    unsigned adj[MAX_K], comp[MAX_K][MAX_K], pattern[1 << MAX_K];
+    int numComp[MAX_K], count[1 << MAX_K], numPatterns = 0, numOut = 0, i, j, u;
+    long degree = 0;
+    if(!_mhsMark) _mhsMark = Calloc(G->n, sizeof(_mhsMark[0]));
+    for(i=0; i<k; i++) _mhsMark[S[i]] = MHS_IN_S;
+    for(i=0; i<k; i++) for(j=0; j<G->degree[S[i]]; j++) {
+	int w = G->neighbor[S[i]][j];
+	if(_mhsMark[w] == MHS_IN_S) continue;
+	if(!_mhsMark[w]) {
+	    if(numOut == _mhsOutSize) _mhsOut = Realloc(_mhsOut, (_mhsOutSize = MAX(2*_mhsOutSize, 1024)) * sizeof(int));
+	    _mhsOut[numOut++] = w;
+	}
+	_mhsMark[w] |= 1 << i;
+    }
+    memset(count, 0, (1 << k) * sizeof(count[0]));
+    for(i=0; i<numOut; i++) if(!count[_mhsMark[_mhsOut[i]]]++) pattern[numPatterns++] = _mhsMark[_mhsOut[i]];
+    MhsAdjacency(G, S, k, adj);
+    for(u=0; u<k; u++) numComp[u] = MhsComponentsWithout(adj, k, u, comp[u]);
+    for(u=0; u<k; u++) for(j=0; j<numPatterns; j++) if(MhsSwapConnected(pattern[j], comp[u], numComp[u])) {
+	if(degree <= pick && pick < degree + count[pattern[j]]) { // the (pick-degree)'th node with this pattern
+	    long skip = pick - degree;
+	    for(i=0; i<numOut; i++) if(_mhsMark[_mhsOut[i]] == pattern[j] && skip-- == 0) break;
+	    *uPicked = u; *wPicked = _mhsOut[i];
+	}
+	degree += count[pattern[j]];
+    }
+    for(i=0; i<k; i++) _mhsMark[S[i]] = 0;
+    for(i=0; i<numOut; i++) _mhsMark[_mhsOut[i]] = 0;
+    return degree;
+}
+
+static void MhsStepWithoutOoze(GRAPH *G, int k, MHS_WALK *W)
+{
+    int u = -1, w = -1, S[MAX_K];
+    if(W->degree == 0) return; // the component is just S
+    StateDegree(G, W->S, k, (long)(W->degree * RandomUniform()), &u, &w);
+    assert(u >= 0 && w >= 0);
+    memcpy(S, W->S, k * sizeof(int));
+    S[u] = w;
+    long degree = StateDegree(G, S, k, -1, NULL, NULL);
+    if(RandomUniform() * degree < W->degree) { memcpy(W->S, S, k * sizeof(int)); W->degree = degree; }
+}
+
+static void MhsStepWithOoze(GRAPH *G, int k, MHS_WALK *W)
+{
+    int i, u = k * RandomUniform(), x, w;
+    unsigned adj[MAX_K], comp[MAX_K], attach = 0;
+    double forward = 0, backward = 0; // the probabilities of proposing S' from S and vice versa, up to a common factor
+    do x = k * RandomUniform(); while(x == u);
+    w = G->neighbor[W->S[x]][(int)(G->degree[W->S[x]] * RandomUniform())];
+    for(i=0; i<k; i++) if(W->S[i] == w) return; // a rejected move
+    for(i=0; i<k; i++) if(i != u) {
+	if(FastAreConnected(G, W->S[i], w)) { attach |= 1U << i; forward += 1.0 / G->degree[W->S[i]]; }
+	if(FastAreConnected(G, W->S[i], W->S[u])) backward += 1.0 / G->degree[W->S[i]];
+    }
+    MhsAdjacency(G, W->S, k, adj);
+    if(!MhsSwapConnected(attach, comp, MhsComponentsWithout(adj, k, u, comp))) return;
+    if(RandomUniform() * forward < backward) W->S[u] = w;
+}
+
+static double SampleGraphletLuBressan_MCMC_MHS(SET *V, int *Varray, GRAPH *G, int k, int whichCC, Boolean ooze)
+{
+    int i;
+    if(!_mhsWalk) _mhsWalk = Calloc(_numConnectedComponents, sizeof(MHS_WALK));
+    MHS_WALK *W = &_mhsWalk[whichCC];
+    if(!W->started) {
+	SampleGraphletNodeBasedExpansion(V, W->S, G, k, whichCC);
+	if(!ooze) W->degree = StateDegree(G, W->S, k, -1, NULL, NULL);
+	for(i=0; i<MHS_BURN_IN; i++) ooze ? MhsStepWithOoze(G, k, W) : MhsStepWithoutOoze(G, k, W);
+	W->started = true;
+    }
+    else if(ooze) MhsStepWithOoze(G, k, W);
+    else MhsStepWithoutOoze(G, k, W);
+    SetEmpty(V);
+    for(i=0; i<k; i++) SetAdd(V, (Varray[i] = W->S[i]));
+    return 1.0;
+}
+
+double SampleGraphletLuBressan_MCMC_MHS_without_Ooze(SET *V, int *Varray, GRAPH *G, int k, int whichCC)
+{
+    return SampleGraphletLuBressan_MCMC_MHS(V, Varray, G, k, whichCC, false); // slower
+}
+
+double SampleGraphletLuBressan_MCMC_MHS_with_Ooze(SET *V, int *Varray, GRAPH *G, int k, int whichCC)
+{
+    return SampleGraphletLuBressan_MCMC_MHS(V, Varray, G, k, whichCC, true); // faster!
+}
 
 /*
 * Very slow: sample k nodes uniformly at random and throw away ones that are disconnected.
@@ -879,21 +1379,18 @@ double SampleWindowMCMC(SET *V, int *Varray, GRAPH *G, int W, int whichCC)
 	assert(W == _windowSize);
 	static Boolean setup = false;
 	static int currSamples = 0;
-	static MULTISET *XLS = NULL;
-	static QUEUE *XLQ = NULL;
+	static MCMC_WINDOW *XL = NULL;
 	static int Xcurrent[mcmc_d];
-	if (!XLQ || !XLS ) {
-		XLQ = QueueAlloc(W*mcmc_d);
-		XLS = MultisetAlloc(G->n);
-	}
+	if (!XL)
+		XL = McmcWindowAlloc(mcmc_d*_MCMC_L);
 
 	if (!setup || (_numSamples/2 == currSamples++)) {
 		setup = true;
-		WalkLSteps(XLS, XLQ, Xcurrent, G, W, whichCC, -1);
+		WalkLSteps(XL, Xcurrent, G, W, whichCC, -1);
 	} else {
 		do  {
-			crawlOneStep(XLS, XLQ, Xcurrent, G);
-		} while (MultisetSupport(XLS) != W);  //Keep crawling until we have W distinct vertices, Crawl at least once
+			crawlOneStep(XL, Xcurrent, G);
+		} while (McmcWindowSupport(XL) != W);  //Keep crawling until we have W distinct vertices, Crawl at least once
 	}
 	int node, numNodes = 0, i, j, graphletDegree;
 	SetEmpty(V);
@@ -901,7 +1398,7 @@ double SampleWindowMCMC(SET *V, int *Varray, GRAPH *G, int W, int whichCC)
 	for (i = 0; i < _MCMC_L; i++) {
 		graphletDegree = -2; //The edge between the vertices in the graphlet isn't included and is double counted
 		for (j = 0; j < mcmc_d; j++) {
-			node = (XLQ->queue[(XLQ->front + (mcmc_d*i)+j) % XLQ->maxSize]).i;
+			node = McmcWindowEntry(XL, mcmc_d*i+j);
 			if (!SetIn(V, node)) {
 				Varray[numNodes++] = node;
 				SetAdd(V, node);
@@ -911,10 +1408,91 @@ double SampleWindowMCMC(SET *V, int *Varray, GRAPH *G, int W, int whichCC)
 	return 1.0;
 }
 
+/*
+** -s INDEX scratch space, sized to the graph once rather than per recursion level. _indexSeen[v] == the stamp of the
+** current level iff v has already been considered for that level's frontier. Each level's frontier lives on one
+** stack, each on top of its parent's, as keys that sort by degree (descending) and then node (ascending).
+*/
+static int *_indexSeen, _indexSeenSize, _indexStamp;
+static unsigned long *_indexFrontier;
+static int _indexFrontierSize;
+#define IndexFrontierKey(G,v) ((unsigned long)(INT_MAX - (G)->degree[v]) << 32 | (unsigned)(v))
+#define IndexFrontierNode(key) ((int)((key) & 0xFFFFFFFFUL))
+#define IndexFrontierDegree(key) (INT_MAX - (int)((key) >> 32))
+
+static int CompareUnsignedLong(const void *a, const void *b)
+{
+    unsigned long i = *(const unsigned long*)a, j = *(const unsigned long*)b;
+    return i < j ? -1 : i > j;
+}
+
+// Push onto the frontier stack, starting at base, the nodes that may extend prev_nodes_array; returns the new top.
+static int IndexFrontier(GRAPH *G, int *prev_nodes_array, int prev_nodes_count, int *degreeOrder, int base)
+{
+    int i, j, top = base, threshold[prev_nodes_count];
+    if(++_indexStamp == INT_MAX) { // wrapped around: start the stamps over
+	for(i=0; i<G->n; i++) _indexSeen[i] = 0;
+	_indexStamp = 1;
+    }
+    if(degreeOrder) { // antidup: a neighbor first found from prev_nodes_array[i] must come after threshold[i] in degreeOrder,
+	// which is the latest of the nodes added after prev_nodes_array[i] (or the first node, for the last one added).
+	threshold[prev_nodes_count-1] = degreeOrder[prev_nodes_array[0]];
+	if(prev_nodes_count > 1) threshold[prev_nodes_count-2] = degreeOrder[prev_nodes_array[prev_nodes_count-1]];
+	for(i=prev_nodes_count-3; i>=0; i--)
+	    threshold[i] = MAX(degreeOrder[prev_nodes_array[i+1]], threshold[i+1]);
+    }
+    for(i=0; i<prev_nodes_count; i++) _indexSeen[prev_nodes_array[i]] = _indexStamp;
+    for(i=0; i<prev_nodes_count; i++) {
+	int u = prev_nodes_array[i];
+	if(top + G->degree[u] > _indexFrontierSize) {
+	    while(top + G->degree[u] > _indexFrontierSize) _indexFrontierSize *= 2;
+	    _indexFrontier = Realloc(_indexFrontier, _indexFrontierSize * sizeof(_indexFrontier[0]));
+	}
+	for(j=0; j<G->degree[u]; j++) {
+	    int neigh = G->neighbor[u][j];
+	    if(_indexSeen[neigh] == _indexStamp) continue; // in the graphlet, or already seen as a neighbor of an earlier node
+	    _indexSeen[neigh] = _indexStamp;
+	    if(!degreeOrder || degreeOrder[neigh] > threshold[i])
+		_indexFrontier[top++] = IndexFrontierKey(G, neigh);
+	}
+    }
+    qsort(_indexFrontier + base, top - base, sizeof(_indexFrontier[0]), CompareUnsignedLong);
+    return top;
+}
+
+// The recursion for SampleGraphletIndexAndPrint, with its frontier starting at base on the frontier stack.
+static void IndexExtend(GRAPH* G, int* prev_nodes_array, int prev_nodes_count, int numSamplesPerNode, int *tempCountPtr,
+    int *degreeOrder, int base)
+{
+    static TINY_GRAPH *g;
+    if(!g) g = TinyGraphAlloc(_k);
+    if (prev_nodes_count == _k) { // base case for the recursion: a k-graphlet is found, print it and return
+        if (ProcessGraphlet(G, NULL, prev_nodes_array, _k, g))
+            *tempCountPtr = *tempCountPtr + 1; // increment the count only if the graphlet sampled satisfies the multiplicity constraint
+        return;
+    }
+    int e, top = IndexFrontier(G, prev_nodes_array, prev_nodes_count, degreeOrder, base), numDegrees = 0;
+    // Loop through neighbor nodes with Top N (-lDEGN) degrees
+    // If -lDEGN flag is not given, then will loop through EVERY neighbor nodes in descending order of their degree.
+    for(e=base; e<top; e++) {
+	if(e == base || IndexFrontierDegree(_indexFrontier[e]) != IndexFrontierDegree(_indexFrontier[e-1]))
+	    if(_numWindowRepLimit > 0 && ++numDegrees > _numWindowRepLimit) break;
+	// Set a maximum number N of returned windowReps (-n N) in case there is a bunch
+	// If (-n N) flag is not given, then will return all satisfied windowReps.
+	if (numSamplesPerNode != 0 && *tempCountPtr >= numSamplesPerNode) break;  // already enough samples found
+	prev_nodes_array[prev_nodes_count] = IndexFrontierNode(_indexFrontier[e]);
+	IndexExtend(G, prev_nodes_array, prev_nodes_count + 1, numSamplesPerNode, tempCountPtr, degreeOrder, top);
+	// we don't need to unset prev_nodes_array[prev_nodes_count] because it'll get overwritten anyways
+    }
+}
+
 /**
  * This function builds graphlets to be included into the index for the -s INDEX sampling mode. For each valid sample it takes,
  * it calls the ProcessGraphlet function to print the graphlet directly. It is called inside RunBlantFromGraph function to take
- * the given amount of samples (the amount is given with -n option) for each node in the graph as the start node
+ * the given amount of samples (the amount is given with -n option) for each node in the graph as the start node.
+ * Each step extends the graphlet by every node of its frontier (all neighbors of the graphlet, or with -A those allowed
+ * by degreeOrder) in descending order of degree, ties broken by node number. The work is linear in the neighborhoods
+ * explored: the frontiers are built into scratch space that's allocated once, never by scanning n-bit sets.
  *
  * @param G the graph
  * @param prev_nodes  the temporary set of nodes in the graphlet to build
@@ -924,64 +1502,134 @@ double SampleWindowMCMC(SET *V, int *Varray, GRAPH *G, int W, int whichCC)
  *                      being processed in RunBlantFromGraph function
  */
 void SampleGraphletIndexAndPrint(GRAPH* G, int* prev_nodes_array, int prev_nodes_count, int numSamplesPerNode, int *tempCountPtr, int *degreeOrder) {
-    int i, j, neigh, max_deg=-1, tie_count=0, deg_count=0, Gint;
-    TINY_GRAPH *g = TinyGraphAlloc(_k);
-
-    // Set a maximum number N of returned windowReps (-n N) in case there is a bunch
-    // If (-n N) flag is not given, then will return all satisfied windowReps.
+    assert(!_useAntidup || degreeOrder); // degreeOrder is NULL iff we're not using antidup
+    if(_indexSeenSize < G->n) {
+	Free(_indexSeen);
+	_indexSeen = Calloc(G->n, sizeof(_indexSeen[0]));
+	_indexSeenSize = G->n;
+	_indexStamp = 0;
+    }
+    if(!_indexFrontier) {
+	_indexFrontierSize = 1024;
+	_indexFrontier = Malloc(_indexFrontierSize * sizeof(_indexFrontier[0]));
+    }
     if (numSamplesPerNode != 0 && *tempCountPtr >= numSamplesPerNode) return;  // already enough samples found, no need to search further
-    if (prev_nodes_count == _k) { // base case for the recursion: a k-graphlet is found, print it and return
-        if (ProcessGraphlet(G, NULL, prev_nodes_array, _k, g))
-            *tempCountPtr = *tempCountPtr + 1; // increment the count only if the graphlet sampled satisfies the multiplicity constraint
-        return;
+    IndexExtend(G, prev_nodes_array, prev_nodes_count, numSamplesPerNode, tempCountPtr, degreeOrder, 0);
+}
+
+/*
+** -s EXACT: Wernicke's ESU algorithm, which enumerates every connected induced k-subgraph exactly once, namely from
+** its lowest-numbered node (the "root"). The subgraph grows one node w at a time from an extension set, and w's
+** child extension set is what remains of its parent's plus w's *exclusive* neighbors: those numbered above the root
+** that are neither in nor adjacent to the subgraph so far. Each graphlet found goes straight to ProcessInducedGraphlet.
+** The extension sets of all levels live on one stack, each on top of its parent's. The induced TINY_GRAPH is also
+** built incrementally: placing a node at position i only (re)computes its edges to positions 0..i-1.
+** EnumerateSubgraphsFromRoot hands each subgraph to a visitor instead (see blant-orca.c).
+*/
+int *_exactNextRoot;
+static int *_esuBlocked; // _esuBlocked[u] = number of nodes in the current subgraph that u is equal or adjacent to
+static int *_esuExt, _esuExtSize;
+static unsigned _esuVarray[MAX_K];
+static TINY_GRAPH *_esuG;
+static long _esuCount;
+static ESU_VISITOR _esuVisit; // NULL means ProcessInducedGraphlet
+
+static void EsuBlock(GRAPH *G, int w, int delta)
+{
+    int j;
+    _esuBlocked[w] += delta;
+    for(j=0; j<G->degree[w]; j++) _esuBlocked[G->neighbor[w][j]] += delta;
+}
+
+static void EsuReserve(int size)
+{
+    if(size <= _esuExtSize) return;
+    while(_esuExtSize < size) _esuExtSize *= 2;
+    _esuExt = Realloc(_esuExt, _esuExtSize * sizeof(_esuExt[0]));
+}
+
+// Put node w at position i of the subgraph, replacing whatever edges position i had to positions 0..i-1.
+static void EsuPlace(GRAPH *G, int i, int w)
+{
+    int j;
+    _esuVarray[i] = w;
+    for(j=0; j<i; j++) {
+	Boolean connected = !!FastAreConnected(G, _esuVarray[j], w); // SetIn returns the bit, which needn't fit a Boolean
+	if(connected != !!TinyGraphAreConnected(_esuG, i, j)) {
+	    if(connected) TinyGraphConnect(_esuG, i, j);
+	    else TinyGraphDisconnect(_esuG, i, j);
+	}
     }
+}
 
-    // Populate next_step with the following algorithm
-    SET *next_step;
-    SET *deg_set;
-
-    if (_useAntidup) {
-        antidupFillNextStepSet(&next_step, &deg_set, G, prev_nodes_array, prev_nodes_count, degreeOrder);
-    } else {
-        next_step = SetAlloc(G->n);
-        deg_set = SetAlloc(G->n);
-        for(i=0; i<prev_nodes_count; i++) {
-            for(j=0; j<G->degree[prev_nodes_array[i]]; j++) {
-                neigh = G->neighbor[prev_nodes_array[i]][j];
-                if(!arrayIn(prev_nodes_array, prev_nodes_count, neigh)) {
-                    SetAdd(next_step, neigh);
-                    SetAdd(deg_set, G->degree[neigh]);
-                }
-            }
-        }
+static void ExtendSubgraphESU(GRAPH *G, int k, int root, int size, int extStart, int extEnd)
+{
+    int e, j;
+    for(e = extEnd-1; e >= extStart; e--) { // take nodes off the end of our extension set
+	int w = _esuExt[e], top = extEnd;
+	EsuPlace(G, size, w);
+	if(size+1 == k) {
+	    if(_esuVisit) _esuVisit(G, _esuVarray, k, _esuG);
+	    else ProcessInducedGraphlet(G, NULL, _esuVarray, k, _esuG, TinyGraph2Int(_esuG, k));
+	    ++_esuCount;
+	    continue;
+	}
+	EsuReserve(extEnd + (e - extStart) + G->degree[w]);
+	memcpy(_esuExt + top, _esuExt + extStart, (e - extStart) * sizeof(_esuExt[0]));
+	top += e - extStart;
+	for(j=0; j<G->degree[w]; j++) {
+	    int u = G->neighbor[w][j];
+	    if(u > root && !_esuBlocked[u]) _esuExt[top++] = u;
+	}
+	EsuBlock(G, w, 1);
+	ExtendSubgraphESU(G, k, root, size+1, extEnd, top);
+	EsuBlock(G, w, -1);
     }
+}
 
-    tie_count = SetCardinality(next_step);
-    deg_count = SetCardinality(deg_set);
-    int next_step_arr[tie_count];
-    int deg_arr[deg_count];
-#if PARANOID_ASSERTS
-    assert(SetToArray(next_step_arr, next_step) == tie_count);
-    assert(SetToArray(deg_arr, deg_set) == deg_count);
-#endif
-    SetFree(next_step);
-    SetFree(deg_set);
-    qsort((void*)deg_arr, deg_count, sizeof(deg_arr[0]), descompFunc); //sort degree in descending order
-    int effectiveNumWindowRepLimit = _numWindowRepLimit > 0 ? MIN(_numWindowRepLimit, deg_count) : deg_count;
-    // Loop through neighbor nodes with Top N (-lDEGN) degrees
-    // If -lDEGN flag is not given, then will loop through EVERY neighbor nodes in descending order of their degree.
-    for (i=0; i<effectiveNumWindowRepLimit; i++) {
-        max_deg = deg_arr[i];
-        for(j=0; j<tie_count; j++) {
-            if (G->degree[next_step_arr[j]] == max_deg) {
-                prev_nodes_array[prev_nodes_count] = next_step_arr[j];
-                SampleGraphletIndexAndPrint(G, prev_nodes_array, prev_nodes_count + 1, numSamplesPerNode, tempCountPtr, degreeOrder);
-                // we don't need to unset prev_nodes_array[prev_nodes_count] because it'll get overwritten anyways
-            }
-        }
+// Visits every connected induced k-subgraph whose lowest-numbered node is root; returns how many.
+long EnumerateSubgraphsFromRoot(GRAPH *G, int k, int root, ESU_VISITOR visit)
+{
+    int j, top = 0;
+    if(!_esuBlocked) {
+	_esuBlocked = Calloc(G->n, sizeof(_esuBlocked[0]));
+	_esuExt = Malloc((_esuExtSize = 1024) * sizeof(_esuExt[0]));
+    }
+    if(!_esuG || _esuG->n != k) {
+	if(_esuG) TinyGraphFree(_esuG);
+	_esuG = TinyGraphAlloc(k);
     }
+    _esuVisit = visit;
+    _esuCount = 0;
+    EsuPlace(G, 0, root);
+    EsuReserve(G->degree[root]);
+    for(j=0; j<G->degree[root]; j++)
+	if(G->neighbor[root][j] > root) _esuExt[top++] = G->neighbor[root][j];
+    EsuBlock(G, root, 1);
+    ExtendSubgraphESU(G, k, root, 1, 0, top);
+    EsuBlock(G, root, -1);
+    return _esuCount;
 }
 
+// Processes every connected induced k-graphlet whose lowest-numbered node is root; returns how many.
+long EnumerateGraphletsFromRoot(GRAPH *G, int k, int root)
+{
+    return EnumerateSubgraphsFromRoot(G, k, root, NULL);
+}
+
+// Returns the next root this process should enumerate from, or -1 if none are left. Roots are claimed EXACT_ROOT_CHUNK
+// at a time from _exactNextRoot if it's shared, so processes that get cheap roots simply come back for more.
+int ExactNextRoot(GRAPH *G)
+{
+    static int next, end, privatePool;
+    if(next == end) {
+	int *pool = _exactNextRoot ? _exactNextRoot : &privatePool;
+	next = __sync_fetch_and_add(pool, EXACT_ROOT_CHUNK);
+	if(next >= G->n) { next = end = 0; return -1; }
+	end = MIN(next + EXACT_ROOT_CHUNK, G->n);
+    }
+    return next++;
+}
 
 double SampleGraphlet(GRAPH *G, SET *V, unsigned Varray[], int k) {
     int cc;
@@ -1014,6 +1662,15 @@ double SampleGraphlet(GRAPH *G, SET *V, unsigned Varray[], int k) {
             SampleWindowMCMC(V, Varray, G, k, cc);
         }
 	break;
+    case SAMPLE_MHS:
+	SampleGraphletLuBressan_MCMC_MHS_without_Ooze(V, Varray, G, k, cc);
+	break;
+    case SAMPLE_MHS_OOZE:
+	SampleGraphletLuBressan_MCMC_MHS_with_Ooze(V, Varray, G, k, cc);
+	break;
+    case SAMPLE_COLOR_CODING:
+	overcount = SampleGraphletColorCoding(V, Varray, G, k); // samples from all components at once
+	break;
     case SAMPLE_FROM_FILE:
 	SampleGraphletFromFile(V, Varray, G, k);
 	break;
@@ -8,12 +8,33 @@
 
 #define MAX_TRIES 100		// max # of tries in cumulative sampling before giving up
 #define ALLOW_DISCONNECTED_GRAPHLETS 0
+// EBE falls back to exact counts of the edges leaving each graphlet node when its rejection sampling keeps drawing
+// edges back into the graphlet, rather than retrying up to MAX_TRIES and restarting; 0 gives the original. Both
+// sample the same distribution.
+#define EBE_EXACT_OUTDEGREE 1
+#define EBE_EXACT_AFTER_REJECTIONS 16 // in one graphlet, before EBE switches to exact counts; see EdgeExpansionExactOutdegree
+#define EBE_SCAN_DEGREE 64 // below this degree, EBE finds a new node's neighbors in the graphlet from its neighbor list
+
+// Represent the NBE/RES frontier lazily as the concatenation of its members' neighbor lists, so that adding a hub
+// to the graphlet doesn't cost O(degree). See LazyFrontierDraw in blant-sampling.c.
+#define USE_LAZY_FRONTIER 1
+#define LAZY_FRONTIER_MAX_TRIES 32 // consecutive rejections before falling back to building the exact outset
+#define LAZY_FRONTIER_HUB_DEGREE 256 // Reservoir sampling only goes lazy once a node of at least this degree joins
 
 #ifndef RESERVOIR_MULTIPLIER
 // this*k is the number of steps in the Reservoir walk. 8 seems to work best, empirically.
 #define RESERVOIR_MULTIPLIER 8
 #endif
 
+#ifndef MCMC_CHAINS
+// Number of independent MCMC chains each process advances round-robin. Each step of a chain is a sequence of dependent
+// cache misses (neighbor list, degrees, canon map), so while we process one chain we prefetch what the next ones need.
+// Set to 1 for the classic single walk. (Always 1 with MCMC restarts at every edge, which is inherently sequential.)
+#define MCMC_CHAINS 4
+#endif
+// Graphs with fewer edges than this mostly fit in cache, where the extra chains are pure overhead; use just one.
+#define MCMC_CHAINS_MIN_EDGES (1<<20)
+
 // Below are the sampling methods
 #define SAMPLE_FROM_FILE 0
 #define SAMPLE_ACCEPT_REJECT 1	// makes things REALLY REALLY slow.  Like 10-100 samples per second rather than a million.
@@ -23,6 +44,14 @@
 #define SAMPLE_MCMC 5 // MCMC Algorithm estimates graphlet frequency with a random walk
 #define SAMPLE_FAYE 6
 #define SAMPLE_INDEX 7 // Use deterministic walk to find seeds which are used for extensions
+#define SAMPLE_EXACT 8 // Not sampling at all: enumerate every connected induced k-graphlet exactly once (ESU)
+#define SAMPLE_COLOR_CODING 9 // Color coding: uniformly random colorful k-trees, weighted by spanning trees (blant-cc.c)
+#define SAMPLE_MHS 10 // Lu & Bressan's Metropolis-Hastings walk on connected k-subgraphs: uniform, unweighted samples
+#define SAMPLE_MHS_OOZE 11 // the same, but with cheap "oozing" proposals
+
+typedef void (*ESU_VISITOR)(GRAPH *G, unsigned Varray[], int k, TINY_GRAPH *g); // called on each subgraph -s EXACT finds
+#define EXACT_ROOT_CHUNK 16 // roots claimed at a time from the pool shared by all processes under -s EXACT
+extern int *_exactNextRoot; // with -t, that pool: the next unclaimed root, in memory shared by all the processes
 
 extern int _sampleMethod;
 extern FILE *_sampleFile; // if _sampleMethod is SAMPLE_FROM_FILE
@@ -31,9 +60,24 @@ extern unsigned long int _acceptRejectTotalTries;
 extern int _samplesPerEdge;
 extern int _numSamples;
 
+// The MCMC sliding window: the nodes of the last L d-graphlets walked, oldest first, in a ring buffer; plus a tiny
+// open-addressed hash table mapping each node to its multiplicity in the window, so that we always know the number of
+// distinct nodes (the "support"). Its size depends only on the window, not the graph, so it fits in a few cache lines.
+typedef struct _mcmcWindow {
+    int size, front, count; // capacity of the ring, index of the oldest entry, and number of entries
+    int support, hashMask; // number of distinct nodes; hash table size is hashMask+1, a power of 2 >= 2*size
+    int *ring, *key; // key[h] == -1 means the slot is free
+    unsigned char *mult; // multiplicity of key[h]
+} MCMC_WINDOW;
+#define McmcWindowSupport(W) ((W)->support)
+#define McmcWindowCount(W) ((W)->count)
+#define McmcWindowEntry(W,i) ((W)->ring[((W)->front + (i)) % (W)->size]) // i'th oldest entry
+
 extern unsigned _MCMC_L; // walk length for MCMC algorithm. k-d+1 with d almost always being 2.
 extern Boolean _MCMC_EVERY_EDGE; // Should MCMC restart at each edge
+extern int _lazyFrontierHubDegree; // -s RES<degree>; defaults to LAZY_FRONTIER_HUB_DEGREE
 
+int RandomComponentEdge(int whichCC);
 double SampleGraphletNodeBasedExpansion(SET *V, int *Varray, GRAPH *G, int k, int whichCC);
 double SampleGraphletFaye(SET *V, int *Varray, GRAPH *G, int k, int whichCC);
 double SampleGraphletFromFile(SET *V, int *Varray, GRAPH *G, int k);
@@ -41,14 +85,20 @@ double SampleGraphletEdgeBasedExpansion(SET *V, int *Varray, GRAPH *G, int k, in
 double SampleGraphletLuBressanReservoir(SET *V, int *Varray, GRAPH *G, int k, int whichCC);
 double SampleGraphletAcceptReject(SET *V, int *Varray, GRAPH *G, int k);
 double SampleGraphletMCMC(SET *V, int *Varray, GRAPH *G, int k, int whichCC);
-double SampleGraphletLuBressan_MCMC_MHS_without_Ooze(SET *V, int *Varray, GRAPH *G, int k);
-double SampleGraphletLuBressan_MCMC_MHS_with_Ooze(SET *V, int *Varray, GRAPH *G, int k);
+double SampleGraphletLuBressan_MCMC_MHS_without_Ooze(SET *V, int *Varray, GRAPH *G, int k, int whichCC);
+double SampleGraphletLuBressan_MCMC_MHS_with_Ooze(SET *V, int *Varray, GRAPH *G, int k, int whichCC);
 void SampleGraphletIndexAndPrint(GRAPH* G, int* prev_nodes_array, int prev_nodes_count, int numSamplesPerNode, int *tempCountPtr, int *degreeOrder); // returns void instead of double because this function isn't called in SampleGraphlet (note: all functions return double even though most don't need to; only SampleGraphletMCMC currently needs to so we made all of them return double for consistency)
+int ExactNextRoot(GRAPH *G);
+long EnumerateGraphletsFromRoot(GRAPH *G, int k, int root);
+long EnumerateSubgraphsFromRoot(GRAPH *G, int k, int root, ESU_VISITOR visit);
 static int NumReachableNodes(TINY_GRAPH *g, int startingNode);
-void WalkLSteps(MULTISET *XLS, QUEUE *XLQ, int* X, GRAPH *G, int k, int cc, int edge);
+MCMC_WINDOW *McmcWindowAlloc(int size);
+void McmcWindowEmpty(MCMC_WINDOW *W);
+void McmcWindowFree(MCMC_WINDOW *W);
+void WalkLSteps(MCMC_WINDOW *XL, int* X, GRAPH *G, int k, int cc, int edge);
 double SampleGraphlet(GRAPH *G, SET *V, unsigned Varray[], int k);
-void initializeSlidingWindow(MULTISET *XLS, QUEUE *XLQ, int* X, GRAPH *G, int windowSize, int edge);
-void crawlOneStep(MULTISET *XLS, QUEUE *XLQ, int* X, GRAPH *G);
+void initializeSlidingWindow(MCMC_WINDOW *XL, int* X, GRAPH *G, int windowSize, int edge);
+void crawlOneStep(MCMC_WINDOW *XL, int* X, GRAPH *G);
 int *MCMCGetNeighbor(int *Xcurrent, GRAPH *G);
 
 #endif
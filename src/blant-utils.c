@@ -45,6 +45,143 @@ void SetGlobalCanonMaps(void)
 	orcaOrbitMappingPopulate(BUF, _orca_orbit_mapping, _k);
 }
 
+void AllocNodeCounts(NODE_COUNTS *c, int n, int numIds, const int connected[], int numConnected)
+{
+    int i;
+    assert(!c->narrow && !c->wide && !c->row);
+    c->n = n;
+    c->columns = numConnected;
+    c->column = Malloc(numIds * sizeof(*c->column));
+    for(i=0; i<numIds; i++) c->column[i] = -1;
+    for(i=0; i<numConnected; i++) c->column[connected[i]] = i;
+    if(numConnected > NODE_COUNTS_SPARSE_COLUMNS) c->row = Calloc(n, sizeof(*c->row));
+    else c->narrow = Calloc((unsigned long)n * numConnected, sizeof(*c->narrow));
+#if NODE_COUNTS_QUEUE
+    c->queue = Malloc(NODE_COUNTS_QUEUE * sizeof(*c->queue));
+#endif
+    c->queued = 0;
+}
+
+#define SPARSE_ROW_MIN_BITS 3
+#define SparseRowHash(r, col) (((col) * 2654435769U) >> (32 - (r)->bits)) // Fibonacci hashing
+
+unsigned long SparseRowGet(SPARSE_ROW *r, unsigned col)
+{
+    if(!r->count) return 0;
+    if(!r->column) return r->count[col];
+    unsigned mask = r->size - 1, h = SparseRowHash(r, col);
+    for(; r->column[h]; h = (h+1) & mask) if(r->column[h] == col+1) return r->count[h];
+    return 0;
+}
+
+// Double the hash table, or make the row dense if the bigger table would take as much space.
+static void SparseRowGrow(SPARSE_ROW *r, int columns)
+{
+    SPARSE_ROW old = *r;
+    unsigned i;
+    if(old.size && 2UL*old.size*(sizeof(*r->column)+sizeof(*r->count)) >= columns*sizeof(*r->count)) {
+	r->count = Calloc(columns, sizeof(*r->count));
+	for(i=0; i<old.size; i++) if(old.column[i]) r->count[old.column[i]-1] = old.count[i];
+	r->column = NULL;
+    }
+    else {
+	r->bits = old.size ? old.bits + 1 : SPARSE_ROW_MIN_BITS;
+	r->size = 1U << r->bits;
+	r->used = 0;
+	r->column = Calloc(r->size, sizeof(*r->column));
+	r->count = Malloc(r->size * sizeof(*r->count));
+	for(i=0; i<old.size; i++) if(old.column[i]) *SparseRowSlot(r, old.column[i]-1, columns) = old.count[i];
+    }
+    if(old.size) { Free(old.column); Free(old.count); }
+}
+
+unsigned long *SparseRowSlot(SPARSE_ROW *r, unsigned col, int columns)
+{
+    if(r->count && !r->column) return r->count + col;
+    if(r->count) {
+	unsigned mask = r->size - 1, h = SparseRowHash(r, col);
+	for(; r->column[h]; h = (h+1) & mask) if(r->column[h] == col+1) return r->count + h;
+	if(4*(r->used+1) <= 3*r->size) { // keep it at most 3/4 full
+	    ++r->used;
+	    r->column[h] = col+1;
+	    r->count[h] = 0;
+	    return r->count + h;
+	}
+    }
+    SparseRowGrow(r, columns);
+    return SparseRowSlot(r, col, columns);
+}
+
+void NodeCountsRow(NODE_COUNTS *c, int v, unsigned long row[])
+{
+    int i;
+    if(c->queued) ApplyNodeCountsQueue(c);
+    if(c->row) {
+	SPARSE_ROW *r = c->row + v;
+	if(r->count && !r->column) memcpy(row, r->count, c->columns * sizeof(*row));
+	else {
+	    memset(row, 0, c->columns * sizeof(*row));
+	    for(i=0; i<r->size; i++) if(r->column[i]) row[r->column[i]-1] = r->count[i];
+	}
+    }
+    else if(c->wide) memcpy(row, c->wide + (unsigned long)v * c->columns, c->columns * sizeof(*row));
+    else for(i=0; i<c->columns; i++) row[i] = c->narrow[(unsigned long)v * c->columns + i];
+}
+
+void WidenNodeCounts(NODE_COUNTS *c)
+{
+    unsigned long i, size = (unsigned long)c->n * c->columns;
+    assert(c->narrow && !c->wide);
+    c->wide = Malloc(size * sizeof(*c->wide));
+    for(i=0; i<size; i++) c->wide[i] = c->narrow[i];
+    Free(c->narrow);
+    c->narrow = NULL;
+}
+
+// Apply the queued increments a block at a time: a counting sort by block, then one pass per block.
+void ApplyNodeCountsQueue(NODE_COUNTS *c)
+{
+    static unsigned long *sorted;
+    static int *start, numBlocks; // start[b] = where block b's increments begin in sorted
+    int i, b, queued = c->queued;
+    int blocks = (((unsigned long)c->n * c->columns) >> NODE_COUNTS_BLOCK_BITS) + 1;
+    if(!sorted) sorted = Malloc(NODE_COUNTS_QUEUE * sizeof(*sorted));
+    if(blocks > numBlocks) start = Realloc(start, ((numBlocks = blocks) + 1) * sizeof(*start));
+    memset(start, 0, (blocks + 1) * sizeof(*start));
+    for(i=0; i<queued; i++) ++start[(c->queue[i] >> NODE_COUNTS_BLOCK_BITS) + 1];
+    for(b=0; b<blocks; b++) start[b+1] += start[b];
+    for(i=0; i<queued; i++) sorted[start[c->queue[i] >> NODE_COUNTS_BLOCK_BITS]++] = c->queue[i];
+    c->queued = 0;
+    if(c->row) for(i=0; i<queued; i++)
+	++*SparseRowSlot(c->row + sorted[i] / c->columns, sorted[i] % c->columns, c->columns);
+    else for(i=0; i<queued; i++) {
+	unsigned long j = sorted[i];
+	if(c->narrow) {
+	    if(c->narrow[j] < UINT_MAX) { ++c->narrow[j]; continue; }
+	    WidenNodeCounts(c);
+	}
+	++c->wide[j];
+    }
+}
+
+void FreeNodeCounts(NODE_COUNTS *c)
+{
+    if(c->narrow) Free(c->narrow);
+    if(c->wide) Free(c->wide);
+    if(c->queue) Free(c->queue);
+    if(c->row) {
+	int v;
+	for(v=0; v<c->n; v++) {
+	    if(c->row[v].column) Free(c->row[v].column);
+	    if(c->row[v].count) Free(c->row[v].count);
+	}
+	Free(c->row);
+	c->row = NULL;
+    }
+    Free(c->column);
+    c->narrow = NULL; c->wide = NULL; c->queue = NULL; c->column = NULL;
+}
+
 void LoadMagicTable()
 {
     int i,j;
@@ -74,6 +211,14 @@ void ExtractPerm(char perm[_k], int i)
 	perm[j] = (i32 >> 3*j) & 7;
 }
 
+// Start fetching the canon map (and if needed, permutation) entry for Gint. Both tables are indexed essentially at
+// random and are hundreds of MB for k=8, so a lookup is almost always a cache (and TLB) miss; see SAMPLE_BATCH.
+void PrefetchCanonEntry(int Gint, Boolean perm)
+{
+    Prefetch(&_K[Gint]);
+    if(perm) Prefetch(&Permutations[Gint]);
+}
+
 void InvertPerm(char inv[_k], const char perm[_k])
 {
     int j;
@@ -99,16 +244,6 @@ int descompFunc(const void *a, const void *b)
     return (*j)-(*i);
 }
 
-int nwd_descompFunc(const void *a, const void *b) {
-    int i = ((node_wdegree*)a)->degree_val, j = ((node_wdegree*)b)->degree_val;
-    return j - i;
-}
-
-int nwd_asccompFunc(const void *a, const void *b) {
-    int i = ((node_wdegree*)a)->degree_val, j = ((node_wdegree*)b)->degree_val;
-    return i - j;
-}
-
 // Given the big graph G and a set of nodes in V, return the TINY_GRAPH created from the induced subgraph of V on G.
 TINY_GRAPH *TinyGraphInducedFromGraph(TINY_GRAPH *Gv, GRAPH *G, int *Varray)
 {
@@ -127,155 +262,88 @@ int getMaximumIntNumber(int K)
     return pow(2, num_of_bits);
 }
 
-int* enumerateDegreeOrder(GRAPH *G) {
-    node_wdegree orderArray[G->n];
-    int i;
-
-    for (i = 0; i < G->n; ++i) {
-        orderArray[i].node = i;
-    }
+/*
+** The node order used by -A (antidup) in -s INDEX: descending degree, with ties broken by iterated color refinement
+** (as in the Weisfeiler-Leman test). Each node starts with the rank of its degree as its color. Every round, the
+** nodes are sorted by color and then by the sorted list of their neighbors' colors, and renumbered in that order;
+** so a round only ever splits colors, never reorders them, and costs O(m log n). We stop when a round splits nothing
+** or after DEGREE_ORDER_ROUNDS rounds; nodes still tied at the end are ordered by node number.
+*/
+static GRAPH *_refineG;
+static int *_refineColor, *_refineNeighborColors, *_refineStart; // v's neighbor colors are at _refineStart[v], sorted
+
+static int RefineDegreeCompare(const void *a, const void *b)
+{
+    int u = *(const int*)a, v = *(const int*)b;
+    if(_refineG->degree[u] != _refineG->degree[v]) return _refineG->degree[v] - _refineG->degree[u];
+    return u - v;
+}
 
-    enumerateDegreeOrderHelper(G, orderArray, 0, G->n, 0);
-    int* degreeOrder = malloc(sizeof(int) * G->n);
+// Compare nodes u and v by color, then neighbor colors; nodes of equal color have equal degree.
+static int RefineSignatureCompare(int u, int v)
+{
+    int i, *cu = _refineNeighborColors + _refineStart[u], *cv = _refineNeighborColors + _refineStart[v];
+    if(_refineColor[u] != _refineColor[v]) return _refineColor[u] - _refineColor[v];
+    for(i=0; i<_refineG->degree[u]; i++) if(cu[i] != cv[i]) return cu[i] - cv[i];
+    return 0;
+}
 
-    for (i = 0; i < G->n; ++i) {
-        degreeOrder[orderArray[i].node] = i;
-    }
+static int RefineCompare(const void *a, const void *b)
+{
+    int u = *(const int*)a, v = *(const int*)b, c = RefineSignatureCompare(u, v);
+    return c ? c : u - v;
+}
 
-    return degreeOrder;
+static int IntAscending(const void *a, const void *b)
+{
+    int i = *(const int*)a, j = *(const int*)b;
+    return i - j;
 }
 
-void enumerateDegreeOrderHelper(GRAPH *G, node_wdegree* orderArray, int start, int end, int layer) {
-    // this is a temporary solution that will stop this function if it's called on two nodes with identical neighbors. this is pretty common since there are a lot of nodes of degree 1 and if both of them have the same neighbor, the algorithm will go through the entire graph before declaring them a tie. this just does that earlier while barely missing out on any real ties. I'm leaving this temporary solution here because the whole thing is temporary; I'm gonna test out many different methods of sorting the array
-    if (layer >= 3) {
-        return;
+int* enumerateDegreeOrder(GRAPH *G) {
+    int i, j, round, numColors, *order = Malloc(G->n * sizeof(int)), *newColor = Malloc(G->n * sizeof(int));
+    _refineG = G;
+    _refineColor = Malloc(G->n * sizeof(int));
+    _refineStart = Malloc((G->n + 1) * sizeof(int));
+    _refineStart[0] = 0;
+    for(i=0; i<G->n; i++) {
+        order[i] = i;
+        _refineStart[i+1] = _refineStart[i] + G->degree[i];
     }
+    _refineNeighborColors = Malloc((_refineStart[G->n] + 1) * sizeof(int));
 
-    // fill in degree vals in orderArray based on the layer, from start to end
-    SET *old_nodes = SetAlloc(G->n);
-    SET *new_nodes = SetAlloc(G->n);
-    SET *all_nodes = SetAlloc(G->n);
-    int curr_i, curr_node, curr_layer, old_i, old_node, neigh_i, neigh_node, layer_deg_sum, i;
-
-    for (curr_i = start; curr_i < end; ++curr_i) {
-        curr_node = orderArray[curr_i].node;
-        SetAdd(old_nodes, curr_node);
-        SetAdd(all_nodes, curr_node);
-
-        for (curr_layer = 0; curr_layer < layer; ++curr_layer) {
-            int old_nodes_count = SetCardinality(old_nodes);
-            int old_nodes_arr[old_nodes_count];
-            assert(SetToArray(old_nodes_arr, old_nodes) == old_nodes_count);
-
-            for (old_i = 0; old_i < old_nodes_count; ++old_i) {
-                old_node = old_nodes_arr[old_i];
-
-                for (neigh_i = 0; neigh_i < G->degree[old_node]; ++neigh_i) {
-                    neigh_node = G->neighbor[old_node][neigh_i];
-
-                    if (!SetIn(all_nodes, neigh_node)) {
-                        SetAdd(new_nodes, neigh_node);
-                        SetAdd(all_nodes, neigh_node);
-                    }
-                }
-            }
-
-            SetFree(old_nodes); // doing this is faster than copying new_nodes to old_nodes
-            old_nodes = new_nodes;
-            new_nodes = SetAlloc(G->n);
-        }
-
-        int old_nodes_count = SetCardinality(old_nodes);
-        int old_nodes_arr[old_nodes_count];
-        assert(SetToArray(old_nodes_arr, old_nodes) == old_nodes_count);
-        layer_deg_sum = 0;
-
-        for (old_i = 0; old_i < old_nodes_count; ++old_i) {
-            old_node = old_nodes_arr[old_i];
-            layer_deg_sum += G->degree[old_node];
-        }
-
-        orderArray[curr_i].degree_val = layer_deg_sum;
-        SetEmpty(old_nodes);
-        SetEmpty(all_nodes);
+    qsort(order, G->n, sizeof(int), RefineDegreeCompare);
+    for(i=0, numColors=0; i<G->n; i++) {
+        if(i > 0 && G->degree[order[i]] != G->degree[order[i-1]]) ++numColors;
+        _refineColor[order[i]] = numColors;
     }
-
-    SetFree(old_nodes);
-    SetFree(new_nodes);
-
-    // sort start through end by degree val
-    qsort((void*)(orderArray + start), end - start, sizeof(node_wdegree), nwd_descompFunc);
-
-    // sort next layer for all tied sections between start and end
-    int new_start;
-    int new_end;
-
-    for (i = start; i < end; ++i) {
-        if (i == start || orderArray[i].degree_val != orderArray[i - 1].degree_val) {
-            new_start = i;
+    ++numColors;
+
+    for(round=0; round < DEGREE_ORDER_ROUNDS && numColors < G->n; round++) {
+        int oldNumColors = numColors;
+        for(i=0; i<G->n; i++) {
+            int *colors = _refineNeighborColors + _refineStart[i];
+            for(j=0; j<G->degree[i]; j++) colors[j] = _refineColor[G->neighbor[i][j]];
+            qsort(colors, G->degree[i], sizeof(int), IntAscending);
         }
-
-        if (i == end || orderArray[i].degree_val != orderArray[i + 1].degree_val) {
-            new_end = i + 1;
-
-            if (new_end - new_start >= 2) { // make sure it's a tie with more than one number
-                if (orderArray[i].degree_val != 0) { // if the degree is 0, it's an edge case because none of the nodes' degree_vals will change, causing an infinite loop
-                    enumerateDegreeOrderHelper(G, orderArray, new_start, new_end, layer + 1);
-                }
-            }
+        qsort(order, G->n, sizeof(int), RefineCompare);
+        // renumber in sorted order; the comparisons need the old colors, so don't overwrite them until we're done
+        for(i=0, numColors=0; i<G->n; i++) {
+            if(i > 0 && RefineSignatureCompare(order[i-1], order[i])) ++numColors;
+            newColor[i] = numColors;
         }
+        ++numColors;
+        for(i=0; i<G->n; i++) _refineColor[order[i]] = newColor[i];
+        if(numColors == oldNumColors) break; // stable
     }
-}
 
-void antidupFillNextStepSet(SET **next_step_pointer, SET **deg_set_pointer, GRAPH *G, int *prev_nodes_array, int prev_nodes_count, int *degreeOrder) {
-    assert(_useAntidup); // make sure this setting is set
-    assert(degreeOrder != NULL); // assert this because degreeOrder is NULL when useAntidup is true
-    int i, j, neigh, rolling_max[prev_nodes_count];
-
-    int last_degree_order = degreeOrder[prev_nodes_array[prev_nodes_count-1]];
-    rolling_max[prev_nodes_count-1] = last_degree_order;
-    for(i=prev_nodes_count-2; i>=0; i--) {
-        int curr_node = prev_nodes_array[i];
-        int curr_degree_order = degreeOrder[curr_node];
-        if (curr_degree_order > rolling_max[i + 1]) {
-            rolling_max[i] = curr_degree_order;
-        } else {
-            rolling_max[i] = rolling_max[i + 1];
-        }
-    }
-    // Then, go forwards in the array and find valid neighbors
-    SET *next_step = SetAlloc(G->n);
-    SET *deg_set = SetAlloc(G->n);
-    *next_step_pointer = next_step;
-    *deg_set_pointer = deg_set;
-    SET *all_neighbors = SetAlloc(G->n);
-    int first_degree_order = degreeOrder[prev_nodes_array[0]];
-    for(i=0; i<prev_nodes_count; i++) {
-        for(j=0; j<G->degree[prev_nodes_array[i]]; j++) { // loop through all neighbors for the current node
-            neigh = G->neighbor[prev_nodes_array[i]][j];
-            int neigh_degree_order = degreeOrder[neigh];
-            if (!SetIn(all_neighbors, neigh) && !arrayIn(prev_nodes_array, prev_nodes_count, neigh)) { // we're only processing it if it's not an old neighbor and it's not a node in the graphlet we're building
-                Boolean neigh_is_valid = true;
-                if (i == prev_nodes_count - 1) {
-                    if (neigh_degree_order > first_degree_order) {
-                        neigh_is_valid = true;
-                    } else {
-                        neigh_is_valid = false;
-                    }
-                } else {
-                    if (neigh_degree_order > rolling_max[i + 1]) {
-                        neigh_is_valid = true;
-                    } else {
-                        neigh_is_valid = false;
-                    }
-                }
-                if (neigh_is_valid) {
-                    SetAdd(next_step, neigh);
-                    SetAdd(deg_set, G->degree[neigh]);
-                }
-                SetAdd(all_neighbors, neigh);
-            }
-        }
-    }
-    SetFree(all_neighbors);
+    int* degreeOrder = Malloc(sizeof(int) * G->n);
+    for (i = 0; i < G->n; ++i)
+        degreeOrder[order[i]] = i;
+    Free(order);
+    Free(newColor);
+    Free(_refineColor);
+    Free(_refineStart);
+    Free(_refineNeighborColors);
+    return degreeOrder;
 }
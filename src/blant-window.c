@@ -392,7 +392,9 @@ void ProcessWindowRep(GRAPH *G, int *VArray, int windowRepInt) {
         case indexGraphlets:
             for(i=0; i<_windowSize; i++) PrintNode((i>0)*' ', VArray[i]);
            	// printf("\n");
-            printf("\n%i %i\n", windowRepInt, _numWindowRep);
+            char line[BUFSIZ];
+            sprintf(line, "\n%i %i\n", windowRepInt, _numWindowRep);
+            PutIndexLine(line);
             for(i=0; i<_numWindowRep; i++)
             {
                 if(!((_windowRep_limit_method && NodeSetSeenRecently(G, _windowReps[limitIndex[i]], _k)) ||
@@ -406,7 +408,7 @@ void ProcessWindowRep(GRAPH *G, int *VArray, int windowRepInt) {
                             else
                                 PrintNode((j>0)*' ',_windowReps[i][j]);
                         }
-                    printf("\n");
+                    PutIndexLine("\n");
                 }
             }
             break;
@@ -1,5 +1,6 @@
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,6 +18,10 @@
 #include "sorts.h"
 #include "blant-window.h"
 #include "blant-output.h"
+#include "blant-index-format.h"
+#include "blant-orca.h"
+#include "blant-cc.h"
+#include "blant-dedup.h"
 #include "blant-utils.h"
 #include "blant-sampling.h"
 #include "blant-synth-graph.h"
@@ -71,8 +76,7 @@ int _numConnectedOrbits;
 // We do this simply because we know the length of MAX_CANONICALS so we pre-know the length of
 // the first dimension, otherwise we'd need to get more funky with the pointer allocation.
 // Only one of these actually get allocated, depending upon outputMode.
-unsigned long int *_graphletDegreeVector[MAX_CANONICALS];
-unsigned long int    *_orbitDegreeVector[MAX_ORBITS];
+NODE_COUNTS _graphletDegreeVector, _orbitDegreeVector;
 double *_doubleOrbitDegreeVector[MAX_ORBITS];
 
 double *_cumulativeProb;
@@ -103,7 +107,10 @@ static int NumReachableNodes(TINY_GRAPH *g, int startingNode)
 
 static int **_componentList; // list of lists of components, largest to smallest.
 static double _totalCombinations, *_combinations, *_probOfComponent;
-SET **_componentSet;
+// -x: components with fewer than _exactComponentSize nodes are enumerated exactly rather than sampled (0 means sample
+// everything). The sampled components are the first _numSampledComponents, since they're sorted largest first.
+static int _exactComponentSize, _numSampledComponents;
+int *_componentEdge, *_componentFirstEdge;
 
 void SetBlantDir() {
     char* temp = getenv("BLANT_DIR");
@@ -124,16 +131,14 @@ static int InitializeConnectedComponents(GRAPH *G)
     _combinations = Calloc(G->n, sizeof(double*)); // probably bigger...
     _probOfComponent = Calloc(G->n, sizeof(double*)); // probably bigger...
     _cumulativeProb = Calloc(G->n, sizeof(double*)); // probably bigger...
-    _componentSet = Calloc(G->n, sizeof(SET*));
 
     int nextStart = 0;
     _componentList[0] = Varray;
     for(v=0; v < G->n; v++) if(!SetIn(visited, v))
     {
-	_componentSet[_numConnectedComponents] = SetAlloc(G->n);
 	_componentList[_numConnectedComponents] = Varray + nextStart;
-	GraphVisitCC(G, v, _componentSet[_numConnectedComponents], Varray + nextStart, _componentSize + _numConnectedComponents);
-	SetUnion(visited, visited, _componentSet[_numConnectedComponents]);
+	// GraphVisitCC adds the nodes to visited as it goes, so there's no need for a separate SET per component.
+	GraphVisitCC(G, v, visited, Varray + nextStart, _componentSize + _numConnectedComponents);
 	for(j=0; j < _componentSize[_numConnectedComponents]; j++)
 	{
 	    assert(_whichComponent[Varray[nextStart + j]] == 0);
@@ -156,25 +161,44 @@ static int InitializeConnectedComponents(GRAPH *G)
 	for(j=0; j < _componentSize[biggest]; j++)
 	    _whichComponent[_componentList[biggest][j]] = i;
 	int itmp, *pitmp;
-	SET * stmp;
 	itmp = _componentSize[i];
 	_componentSize[i] = _componentSize[biggest];
 	_componentSize[biggest] = itmp;
 	pitmp = _componentList[i];
 	_componentList[i] = _componentList[biggest];
 	_componentList[biggest] = pitmp;
-    stmp = _componentSet[i];
-    _componentSet[i] = _componentSet[biggest];
-    _componentSet[biggest] = stmp;
 	_combinations[i] = CombinChooseDouble(_componentSize[i], _k);
 	_totalCombinations += _combinations[i];
     }
 
+    // Now build the per-component edge index (a counting sort of the edges by component), so that picking a
+    // starting edge inside a given component is one random draw rather than rejection sampling across all of G.
+    // Since components are sorted largest first, the edges of all components with at least k nodes form a prefix.
+    _componentFirstEdge = Calloc(_numConnectedComponents+1, sizeof(int));
+    _componentEdge = Calloc(MAX(G->numEdges,1), sizeof(int));
+    for(i=0; i < G->numEdges; i++) ++_componentFirstEdge[_whichComponent[G->edgeList[2*i]]+1];
+    for(i=0; i < _numConnectedComponents; i++) _componentFirstEdge[i+1] += _componentFirstEdge[i];
+    assert(_componentFirstEdge[_numConnectedComponents] == G->numEdges);
+    int *nextEdge = Malloc(_numConnectedComponents*sizeof(int));
+    memcpy(nextEdge, _componentFirstEdge, _numConnectedComponents*sizeof(int));
+    for(i=0; i < G->numEdges; i++) _componentEdge[nextEdge[_whichComponent[G->edgeList[2*i]]]++] = i;
+    Free(nextEdge);
+
+    // _probOfComponent is each component's share of all k-subsets, but only the sampled components can be chosen.
+    double sampledCombinations = 0.0;
+    for(_numSampledComponents=0; _numSampledComponents < _numConnectedComponents &&
+	_componentSize[_numSampledComponents] >= MAX(_exactComponentSize, _k); _numSampledComponents++)
+	sampledCombinations += _combinations[_numSampledComponents];
+    if(_numSampledComponents == 0) {
+	if(_exactComponentSize) Fatal("-x %d: no connected component has that many nodes, so there's nothing to sample "
+	    "(use -s EXACT to enumerate everything)", _exactComponentSize);
+	Fatal("no connected component has at least %d nodes", _k);
+    }
     double cumulativeProb = 0.0;
     for(i=0; i< _numConnectedComponents; i++)
     {
 	_probOfComponent[i] =  _combinations[i] / _totalCombinations;
-	_cumulativeProb[i] = cumulativeProb + _probOfComponent[i];
+	_cumulativeProb[i] = cumulativeProb + (i < _numSampledComponents ? _combinations[i] / sampledCombinations : 0);
 	cumulativeProb = _cumulativeProb[i];
 	if(cumulativeProb > 1)
 	{
@@ -183,6 +207,7 @@ static int InitializeConnectedComponents(GRAPH *G)
 	}
 	//printf("Component %d has %d nodes and probability %lf, cumulative prob %lf\n", i, _componentSize[i], _probOfComponent[i], _cumulativeProb[i]);
     }
+    for(i=_numSampledComponents-1; i < _numConnectedComponents; i++) _cumulativeProb[i] = 1.0; // absorb roundoff
     SetFree(visited);
     return _numConnectedComponents;
 }
@@ -209,9 +234,8 @@ void initializeMCMC(GRAPH* G, int k, int numSamples) {
 	_MCMC_L = k - mcmc_d  + 1;
 	// Count the number of valid edges to start from
 	int i, validEdgeCount = 0;
-	for (i = 0; i < G->numEdges; i++)
-		if (_componentSize[_whichComponent[G->edgeList[2*i]]] >= k)
-			validEdgeCount++;
+	for (i = 0; i < _numConnectedComponents && _componentSize[i] >= k; i++)
+		validEdgeCount += _componentFirstEdge[i+1] - _componentFirstEdge[i];
 	_samplesPerEdge =  (numSamples + (validEdgeCount / 2)) / validEdgeCount; // Division rounding up for samples per edge
 
 	char BUF[BUFSIZ];
@@ -239,80 +263,206 @@ void finalizeMCMC() {
 #endif
 	    totalConcentration += _graphletConcentration[i];
 	}
+	if (totalConcentration == 0) return; // eg., a parent process that took no samples of its own
 	for (i = 0; i < _numCanon; i++) {
 	    _graphletConcentration[i] /= totalConcentration;
 	}
 }
 
-// Compute the degree of the state in the state graph (see Lu&Bressen)
-// Given the big graph G, and a set of nodes S (|S|==k), compute the
-// degree of the *state* represented by these nodes, which is:
-//     Degree(S) = k*|NN2| + (k-1)*|NN1|
-// where NN1 is the set of nodes one step outside S that have only 1 connection back into S,
-// and   NN2 is the set of nodes one step outside S that have more than 1 connection back into S.
-static int StateDegree(GRAPH *G, SET *S)
+// MCMC and color coding (-s CC) weight each sample, accumulating the weights in _graphletConcentration.
+static Boolean WeightedSamples(void) { return _sampleMethod == SAMPLE_MCMC || _sampleMethod == SAMPLE_COLOR_CODING; }
+
+// The raw frequency of graphlet canon among the samples taken so far: its count, or for MCMC the sum of the overcount
+// weights of its samples (which finalizeMCMC later normalizes into a concentration).
+static double RawFrequency(int canon)
 {
-#if PARANOID_ASSERTS
-    assert(SetCardinality(S) == _k);
-#endif
-    int Varray[_k]; // array of elements in S
-    SetToArray(Varray, S);
+    return WeightedSamples() ? _graphletConcentration[canon] : _graphletCount[canon];
+}
+
+// The expected number of times graphlet canon appears among our own numSamples samples. Call after finalizeMCMC.
+static double SampleFrequency(int canon, int numSamples)
+{
+    return WeightedSamples() ? _graphletConcentration[canon]*numSamples : _graphletCount[canon];
+}
 
-    SET *outSet=SetAlloc(G->n); // the set of nodes in G that are one step outside S, from *anybody* in S
-    int connectCount[G->n]; // for each node in the outset, count the number of times it's connected into S
-    memset(connectCount, 0, G->n * sizeof(int)); // set them all to zero
+// Frequencies reported by child processes, in the same units as SampleFrequency (see RunBlantInThreads).
+static double _childFrequency[MAX_CANONICALS];
+// Frequencies contributed by the components that -x enumerates exactly, also in those units (see EnumerateSmallComponents).
+static double _exactFrequency[MAX_CANONICALS];
+static long _childSamples; // the number of samples the child processes took, if any
 
-    int i, j, numOut = 0;
-    for(i=0;i<_k;i++) for(j=0; j<G->degree[Varray[i]]; j++)
-    {
-	int neighbor = G->neighbor[Varray[i]][j];
-	if(!SetIn(S, neighbor))
-	{
-	    SetAdd(outSet, neighbor);
-	    if(connectCount[neighbor] == 0) ++numOut;
-	    ++connectCount[neighbor];
-	}
+// This converts graphlet frequencies to concentrations or integers based on the sampling algorithm and command line
+// arguments, combining our own samples with those merged from child processes (if any).
+void convertFrequencies(int numSamples)
+{
+    int i;
+    double frequency[_numCanon], total = 0;
+    for (i = 0; i < _numCanon; i++)
+	total += (frequency[i] = _childFrequency[i] + SampleFrequency(i, numSamples) + _exactFrequency[i]);
+    for (i = 0; i < _numCanon; i++) {
+	if (_freqDisplayMode == count)
+	    _graphletCount[i] = frequency[i];
+	else
+	    _graphletConcentration[i] = total > 0 ? frequency[i] / total : 0;
     }
-#if PARANOID_ASSERTS
-    assert(SetCardinality(outSet) == numOut);
-#endif
-    int outArray[numOut], Sdeg = 0;
-    i = SetToArray(outArray, outSet);
-    assert(i == numOut);
-    for(i=0; i < numOut; i++)
-    {
-	switch(connectCount[outArray[i]])
-	{
-	case 0: break;
-	case 1: Sdeg += _k-1; break;
-	default:  Sdeg += _k; break;
-	}
+}
+
+// Sequential estimation for -c: split the samples into batches of CONFIDENCE_BATCH, compute the graphlet concentrations
+// within each batch, and use the variance of these batch means to put a confidence interval on each concentration.
+// (Unlike the binomial variance, batch means remain valid for MCMC's correlated and weighted samples.) We're done
+// once every connected graphlet seen so far has a 95% confidence interval of at most +/- confidence*(its concentration).
+#define CONFIDENCE_BATCH 100000 // samples per batch; with -t, this is also the number of samples per child process
+#define CONFIDENCE_MIN_BATCHES 10 // don't trust the variance estimate until we have at least this many batches
+#define CONFIDENCE_Z 1.96 // two-sided 95% normal quantile
+#define CONFIDENCE_MAX_SAMPLES 100000000 // limit when -n isn't also given
+static int _numConfidenceBatches;
+static double _batchConcentrationSum[MAX_CANONICALS], _batchConcentrationSumSq[MAX_CANONICALS];
+
+// Add one batch, given the raw frequency of each graphlet within it.
+static void ConfidenceAddBatch(double frequency[])
+{
+    int i;
+    double total = 0;
+    for (i = 0; i < _numCanon; i++) if (SetIn(_connectedCanonicals, i)) total += frequency[i];
+    if (total == 0) return;
+    for (i = 0; i < _numCanon; i++) if (SetIn(_connectedCanonicals, i)) {
+	double c = frequency[i] / total;
+	_batchConcentrationSum[i] += c;
+	_batchConcentrationSumSq[i] += c*c;
     }
-    SetFree(outSet);
-    return Sdeg;
+    ++_numConfidenceBatches;
 }
 
+// Returns the ordinal of the graphlet whose confidence interval is widest relative to its concentration,
+// and sets *precision to that relative half-width.
+static int ConfidenceWorst(double *precision)
+{
+    int i, n = _numConfidenceBatches, worst = -1;
+    *precision = 0;
+    if (n < 2) { *precision = HUGE_VAL; return worst; }
+    for (i = 0; i < _numCanon; i++) if (SetIn(_connectedCanonicals, i) && _batchConcentrationSum[i] > 0) {
+	double mean = _batchConcentrationSum[i] / n, var = (_batchConcentrationSumSq[i] - n*mean*mean) / (n-1);
+	double halfWidth = CONFIDENCE_Z * sqrt(MAX(var, 0) / n) / mean;
+	if (halfWidth > *precision) { *precision = halfWidth; worst = i; }
+    }
+    return worst;
+}
 
-// This converts graphlet frequencies to concentrations or integers based on the sampling algorithm and command line arguments
-void convertFrequencies(int numSamples)
+static Boolean ConfidenceReached(void)
 {
-    int i;
-    if (_sampleMethod == SAMPLE_MCMC) {
-	if (_freqDisplayMode == count) {
-	    for (i = 0; i < _numCanon; i++) {
-		_graphletCount[i] = _graphletConcentration[i] * numSamples;
+    double precision;
+    if (_numConfidenceBatches < CONFIDENCE_MIN_BATCHES) return false;
+    ConfidenceWorst(&precision);
+    return precision <= confidence;
+}
+
+// -s CC keeps one batch per coloring even without -c, and reports how precise its estimates are.
+static void ColorCodingErrorWarning(void)
+{
+    double precision;
+    int worst = ConfidenceWorst(&precision);
+    if (_numConfidenceBatches < 2)
+	Warning("-s CC: no error estimate, since that needs at least 2 colorings (-n %d)", 2*CC_SAMPLES_PER_COLORING);
+    else Warning("-s CC: after %d colorings, all graphlet concentrations are within +/-%g (relative, 95%% confidence)%s%s",
+	_numConfidenceBatches, precision, worst < 0 ? "" : "; least precise is ", worst < 0 ? "" : PrintCanonical(worst));
+}
+
+static void ConfidenceNotReachedWarning(int numSamples)
+{
+    double precision;
+    int worst = ConfidenceWorst(&precision);
+    if (worst < 0) Warning("-c %g not reached after %d samples", confidence, numSamples);
+    else Warning("-c %g not reached after %d samples; least precise graphlet %s is within +/-%g",
+	confidence, numSamples, PrintCanonical(worst), precision);
+}
+
+// -T: a wall-clock time budget, measured from program start so BLANT fits a fixed time slot. Every job samples
+// until _deadline, and results are normalized by however many samples were actually taken.
+#define DEADLINE_CHECK_INTERVAL 1024 // samples between looks at the clock
+#define TIME_BUDGET_MAX_SAMPLES (INT_MAX/2) // limit when -n isn't also given
+static double _startTime, _timeBudget, _deadline; // _deadline is 0 when there's no time budget
+static long *_samplesTaken; // shared with child processes so the parent can report the total
+
+// Memory that stays shared with child processes after they're forked
+static void *SharedAlloc(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED) Fatal("cannot allocate %ld bytes of shared memory", (long)size);
+    memset(p, 0, size);
+    return p;
+}
+
+static double WallTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static Boolean DeadlinePassed(void) { return _deadline > 0 && WallTime() >= _deadline; }
+
+// -x: enumerate every graphlet in the components too small to sample (as -s EXACT does), and give them the weight that
+// sampling would have: had we sampled all components, component c would have received numSamples*P(c)/P(sampled) of
+// them, where P is the probability the samplers choose a component with (see InitializeConnectedComponents). That
+// weight is spread over c's graphlets in their exact proportions, rather than in those of a few random samples.
+// Nothing else touches the nodes of these components, so their GDV/ODV rows can simply be scaled in place.
+static void EnumerateSmallComponents(GRAPH *G, int k, long numSamples)
+{
+    int c, i, j;
+    double sampledProb = 0;
+    static unsigned long before[MAX_CANONICALS];
+    for(c=0; c<_numSampledComponents; c++) sampledProb += _probOfComponent[c];
+    for(c=_numSampledComponents; c<_numConnectedComponents && _componentSize[c] >= k; c++) {
+	long found = 0;
+	if(_outputMode == graphletFrequency) memcpy(before, _graphletCount, _numCanon * sizeof(before[0]));
+	for(i=0; i<_componentSize[c]; i++) found += EnumerateGraphletsFromRoot(G, k, _componentList[c][i]);
+	assert(found > 0); // any connected component with at least k nodes has a connected k-graphlet
+	double weight = numSamples * _probOfComponent[c] / sampledProb / found;
+	switch(_outputMode) {
+	case graphletFrequency:
+	    for(j=0; j<_numCanon; j++) {
+		_exactFrequency[j] += weight * (_graphletCount[j] - before[j]);
+		_graphletCount[j] = before[j];
 	    }
-	}
-    }
-    else {
-	if (_freqDisplayMode == concentration) {
-	    for (i = 0; i < _numCanon; i++) {
-		_graphletConcentration[i] = _graphletCount[i] / (double)numSamples;
+	    break;
+	case outputGDV:
+	    for(i=0; i<_componentSize[c]; i++) for(j=0; j<_numCanon; j++)
+		SET_GDV(_componentList[c][i], j, GDV(_componentList[c][i], j) * weight + 0.5);
+	    break;
+	case outputODV:
+	    for(i=0; i<_componentSize[c]; i++) for(j=0; j<_numConnectedOrbits; j++) {
+		int o = _connectedOrbits[j];
+		SET_ODV(_componentList[c][i], o, ODV(_componentList[c][i], o) * weight + 0.5);
 	    }
+	    break;
+	default: Abort("EnumerateSmallComponents: unsupported output mode %d", _outputMode);
 	}
     }
 }
 
+// For NBE and EBE we take samples in batches: sample and canonicalize SAMPLE_BATCH graphlets, prefetching
+// the canon map and permutation entries of each as we go, and only then process them all (in order). For large k those
+// tables are hundreds of MB and each lookup is a miss, so this lets the misses overlap rather than serialize.
+#define SAMPLE_BATCH 64
+static struct {
+    unsigned Varray[SAMPLE_BATCH][MAX_K+1];
+    int Gint[SAMPLE_BATCH];
+    TINY_GRAPH g[SAMPLE_BATCH];
+} _batch;
+
+static void SampleGraphletBatch(GRAPH *G, SET *V, int k, int batchSize)
+{
+    int b;
+    Boolean needPerm = (_outputMode != graphletFrequency && _outputMode != outputGDV);
+    assert(batchSize <= SAMPLE_BATCH);
+    for(b=0; b<batchSize; b++)
+    {
+	SampleGraphlet(G, V, _batch.Varray[b], k); // NBE and EBE samples all weigh 1
+	_batch.g[b].n = k;
+	TinyGraphInducedFromGraph(&_batch.g[b], G, _batch.Varray[b]);
+	PrefetchCanonEntry(_batch.Gint[b] = TinyGraph2Int(&_batch.g[b], k), needPerm);
+    }
+}
 
 // This is the single-threaded BLANT function. YOU PROBABLY SHOULD NOT CALL THIS.
 // Call RunBlantInThreads instead, it's the top-level entry point to call once the
@@ -331,6 +481,8 @@ int RunBlantFromGraph(int k, int numSamples, GRAPH *G)
     int varraySize = _windowSize > 0 ? _windowSize : MAX_K + 1;
     unsigned Varray[varraySize];
     InitializeConnectedComponents(G);
+    if (_outputMode == indexGraphlets || _outputMode == indexOrbits || _outputMode == indexMotifs || _outputMode == indexMotifOrbits)
+	IndexOutputInit(G, numSamples);
     if (_sampleMethod == SAMPLE_MCMC)
 	_window? initializeMCMC(G, _windowSize, numSamples) : initializeMCMC(G, k, numSamples);
     if (_outputMode == graphletDistribution) {
@@ -359,10 +511,35 @@ int RunBlantFromGraph(int k, int numSamples, GRAPH *G)
             free(degreeOrder);
         }
     }
+    else if (_sampleMethod == SAMPLE_EXACT) { // enumerate every connected graphlet, claiming roots from a (shared) pool
+	long total = 0;
+	int root;
+	if(OrcaEquationsApply(k)) { // -mo: count from the (k-1)-graphlets instead; see blant-orca.c
+	    OrcaInit(k);
+	    while((root = ExactNextRoot(G)) >= 0) total += EnumerateSubgraphsFromRoot(G, k-1, root, OrcaVisit);
+	    if(!_child) OrcaSolve(G); // children output the raw counts, which the parent adds up before solving
+	}
+	else while((root = ExactNextRoot(G)) >= 0) total += EnumerateGraphletsFromRoot(G, k, root);
+	if(_samplesTaken) __sync_fetch_and_add(_samplesTaken, total);
+	else Warning("-s EXACT: enumerated %ld %d-graphlets", total, OrcaEquationsApply(k) ? k-1 : k);
+    }
     else // sample numSamples graphlets for the entire graph
     {
+	// With -c, stop once the confidence target is reached (children just take one batch each; see RunBlantInThreads)
+	Boolean checkConfidence = (confidence > 0 && numSamples > 0 && !_child && _outputMode == graphletFrequency), confident = false;
+	// -s CC always keeps batches, one per coloring, for its error estimate
+	Boolean trackBatches = checkConfidence || (_sampleMethod == SAMPLE_COLOR_CODING && numSamples > 0 && !_child);
+	Boolean outOfTime = false;
+	int batchSamples = _sampleMethod == SAMPLE_COLOR_CODING ? CC_SAMPLES_PER_COLORING : CONFIDENCE_BATCH;
+	int nextConfidenceCheck = batchSamples, nextDeadlineCheck = 0;
+	double batchStart[_numCanon];
+	for(j=0; j<_numCanon; j++) batchStart[j] = 0;
         for(i=0; (i<numSamples || (_sampleFile && !_sampleFileEOF)) && !_earlyAbort; i++)
         {
+	    if(_deadline && i >= nextDeadlineCheck) { // i samples have been taken so far
+		if((outOfTime = DeadlinePassed())) break;
+		nextDeadlineCheck = i + DEADLINE_CHECK_INTERVAL;
+	    }
             if(_window) {
                 SampleGraphlet(G, V, Varray, _windowSize);
                 _numWindowRep = 0;
@@ -379,6 +556,19 @@ int RunBlantFromGraph(int k, int numSamples, GRAPH *G)
             }
             else if (_outputMode == graphletDistribution)
                 ProcessWindowDistribution(G, V, Varray, k, empty_g, prev_node_set, intersect_node);
+	    else if (_sampleMethod == SAMPLE_NODE_EXPANSION || _sampleMethod == SAMPLE_EDGE_EXPANSION) {
+		static int stuck;
+		int b, batchSize = MIN(SAMPLE_BATCH, numSamples - i);
+		SampleGraphletBatch(G, V, k, batchSize);
+		--i; // the for loop will increment it
+		for(b=0; b<batchSize && !_earlyAbort; b++) {
+		    if(ProcessInducedGraphlet(G, V, _batch.Varray[b], k, &_batch.g[b], _batch.Gint[b])) { ++i; stuck = 0; }
+		    else if(++stuck > numSamples) {
+			Warning("Sampling aborted: no new graphlets discovered after %d attempts", stuck);
+			_earlyAbort = true;
+		    }
+		}
+	    }
             else {
 		static int stuck;
 		// HACK: make the graphlet overcount global; it should really be PASSED into ProcessGraphlet
@@ -393,8 +583,29 @@ int RunBlantFromGraph(int k, int numSamples, GRAPH *G)
 		    }
 		}
             }
+	    if(trackBatches && i+1 >= nextConfidenceCheck) { // i+1 samples have been taken so far
+		double batch[_numCanon];
+		for(j=0; j<_numCanon; j++) {
+		    batch[j] = RawFrequency(j) - batchStart[j];
+		    batchStart[j] = RawFrequency(j);
+		}
+		ConfidenceAddBatch(batch);
+		nextConfidenceCheck += batchSamples;
+		if(checkConfidence && (confident = ConfidenceReached())) { ++i; break; }
+	    }
         }
+	if(confident) {
+	    Warning("all graphlet concentrations are within +/-%g (relative, 95%% confidence) after %d samples", confidence, i);
+	    numSamples = i;
+	}
+	else if(checkConfidence) ConfidenceNotReachedWarning(i);
+	else if(trackBatches) ColorCodingErrorWarning();
+	if(outOfTime) {
+	    if(!_child && _JOBS == 1) Warning("-T %g: time budget reached after %d samples", _timeBudget, i);
+	    numSamples = i;
+	}
 	if(i<numSamples) Warning("only took %d samples out of %d", i, numSamples);
+	if(_samplesTaken) __sync_fetch_and_add(_samplesTaken, i);
     }
 
     // Sampling done. Now generate output for output modes that require it.
@@ -405,18 +616,25 @@ int RunBlantFromGraph(int k, int numSamples, GRAPH *G)
         free(_windowReps);
         if(_windowRep_limit_method) HeapFree(_windowRep_limit_heap);
     }
-    if (_sampleMethod == SAMPLE_MCMC && !_window)
+    if (_exactComponentSize && !_child)
+	EnumerateSmallComponents(G, k, numSamples + _childSamples);
+    if (WeightedSamples() && !_window)
 	finalizeMCMC();
-    if (_outputMode == graphletFrequency && !_window)
+    if (_outputMode == graphletFrequency && !_window && !_child)
 	convertFrequencies(numSamples);
 
     switch(_outputMode)
     {
 	int canon;
-	int orbit_index;
     case indexGraphlets: case indexOrbits: case indexMotifs: case indexMotifOrbits:
-	break; // already printed on-the-fly in the Sample/Process loop above
+	IndexOutputFinish(); // already printed on-the-fly in the Sample/Process loop above, but maybe not written yet
+	break;
     case graphletFrequency:
+	if(_child) { // report our raw frequencies to the parent, at full precision and with ordinal canonical IDs
+	    for(canon=0; canon<_numCanon; canon++) if (SetIn(_connectedCanonicals, canon))
+		printf("%.17g %d\n", SampleFrequency(canon, numSamples), canon);
+	    break;
+	}
 	for(canon=0; canon<_numCanon; canon++) {
 	if (_freqDisplayMode == concentration) {
 	    if (SetIn(_connectedCanonicals, canon)) {
@@ -440,27 +658,9 @@ int RunBlantFromGraph(int k, int numSamples, GRAPH *G)
 	PredictFlushAllCounts(G);
 	break;
 #endif
-    case outputGDV:
-	for(i=0; i < G->n; i++)
-	{
-	    printf("%s", PrintNode(0,i));
-	    for(canon=0; canon < _numCanon; canon++)
-		printf(" %lu", GDV(i,canon));
-	    puts("");
-	}
+    case outputGDV: case outputODV:
+	PrintDegreeVectors(G, k);
 	break;
-    case outputODV:
-        for(i=0; i<G->n; i++) {
-	    printf("%s", PrintNode(0,i));
-	    for(j=0; j<_numConnectedOrbits; j++) {
-		if (k == 4 || k == 5) orbit_index = _connectedOrbits[_orca_orbit_mapping[j]];
-		else orbit_index = _connectedOrbits[j];
-		if (!_MCMC_EVERY_EDGE || _sampleMethod != SAMPLE_MCMC) printf(" %lu", ODV(i,orbit_index));
-		else printf(" %.12f", _doubleOrbitDegreeVector[orbit_index][i]);
-	    }
-	    printf("\n");
-	}
-        break;
     case graphletDistribution:
         for(i=0; i<_numCanon; i++) {
             for(j=0; j<_numCanon; j++)
@@ -473,14 +673,15 @@ int RunBlantFromGraph(int k, int numSamples, GRAPH *G)
 	}
 
 #if PARANOID_ASSERTS // no point in freeing this stuff since we're about to exit; it can take significant time for large graphs.
-    if(_outputMode == outputGDV) for(i=0;i<_numCanon;i++)
-	Free(_graphletDegreeVector[i]);
-    if(_outputMode == outputODV) for(i=0;i<_numOrbits;i++) Free(_orbitDegreeVector[i]);
-	if(_outputMode == outputODV && _MCMC_EVERY_EDGE) for(i=0;i<_numOrbits;i++) Free(_doubleOrbitDegreeVector[i]);
+    if(_graphletDegreeVector.column) FreeNodeCounts(&_graphletDegreeVector);
+    if(_orbitDegreeVector.column) FreeNodeCounts(&_orbitDegreeVector);
+    if(_outputMode == outputODV) for(i=0;i<_numOrbits;i++)
+	if(_doubleOrbitDegreeVector[i]) Free(_doubleOrbitDegreeVector[i]);
     TinyGraphFree(empty_g);
 #endif
     if (_sampleMethod == SAMPLE_ACCEPT_REJECT)
     	fprintf(stderr,"Average number of tries per sample is %g\n", _acceptRejectTotalTries/(double)numSamples);
+    DedupReport();
     SetFree(V);
     SetFree(prev_node_set);
     SetFree(intersect_node);
@@ -497,6 +698,7 @@ FILE *ForkBlant(int k, int numSamples, GRAPH *G)
     int fds[2];
     assert(pipe(fds) >= 0);
     int threadSeed = INT_MAX*RandomUniform(); // this must happen BEFORE the fork for each thread to get a different seed
+    FlushIndexOutput(); // otherwise the child would inherit, and eventually repeat, whatever output we haven't written
     int pid = fork();
     if(pid > 0) // we are the parent
     {
@@ -506,6 +708,7 @@ FILE *ForkBlant(int k, int numSamples, GRAPH *G)
     else if(pid == 0) // we are the child
     {
 	_child = true;
+	IndexOutputDetach(); // the writer process is our parent's
 	_seed = threadSeed;
 	RandomSeed(_seed);
 	(void)close(fds[0]); // we will not be reading from the pipe, so close it.
@@ -538,15 +741,17 @@ int RunBlantInThreads(int k, int numSamples, GRAPH *G)
     int i,j;
     assert(k == _k);
     assert(G->n >= k); // should really ensure at least one connected component has >=k nodes. TODO
-    if(_outputMode == outputGDV) for(i=0;i<_numCanon;i++)
-	_graphletDegreeVector[i] = Calloc(G->n, sizeof(**_graphletDegreeVector));
-    if(_outputMode == outputODV) for(i=0;i<_numOrbits;i++){
-	_orbitDegreeVector[i] = Calloc(G->n, sizeof(**_orbitDegreeVector));
-	for(j=0;j<G->n;j++) _orbitDegreeVector[i][j]=0;
+    // Only connected graphlets and orbits can be counted, so only they get space; and -s MCMCu counts orbits in
+    // doubles, so it doesn't need the integer ODV at all.
+    if(_outputMode == outputGDV) {
+	int connected[_numCanon], numConnected = 0;
+	for(i=0;i<_numCanon;i++) if(SetIn(_connectedCanonicals, i)) connected[numConnected++] = i;
+	AllocNodeCounts(&_graphletDegreeVector, G->n, _numCanon, connected, numConnected);
     }
-    if (_outputMode == outputODV) for(i=0;i<_numOrbits;i++){
-	_doubleOrbitDegreeVector[i] = Calloc(G->n, sizeof(**_doubleOrbitDegreeVector));
-	for(j=0;j<G->n;j++) _doubleOrbitDegreeVector[i][j]=0.0;
+    if(_outputMode == outputODV) {
+	if(_MCMC_EVERY_EDGE && _sampleMethod == SAMPLE_MCMC) for(i=0;i<_numConnectedOrbits;i++)
+	    _doubleOrbitDegreeVector[_connectedOrbits[i]] = Calloc(G->n, sizeof(**_doubleOrbitDegreeVector));
+	else AllocNodeCounts(&_orbitDegreeVector, G->n, _numOrbits, _connectedOrbits, _numConnectedOrbits);
     }
 #if PREDICT
     if(_outputMode == predict) Predict_Init(G);
@@ -564,12 +769,26 @@ int RunBlantInThreads(int k, int numSamples, GRAPH *G)
         Fatal("The sampling method '-s INDEX' does not yet support multithreading (feel free to add it!)");
 
     // At this point, _JOBS must be greater than 1.
+    if(_sampleMethod == SAMPLE_EXACT) {
+	// Each job enumerates from roots claimed from one shared pool until there are none left
+	_exactNextRoot = SharedAlloc(sizeof(*_exactNextRoot));
+	numSamples = _JOBS;
+    }
     int totalSamples = numSamples;
     double meanSamplesPerJob = totalSamples/(double)_JOBS;
+    // With -c, each child takes one batch, and we stop starting new ones once the confidence target is reached
+    Boolean checkConfidence = (confidence > 0 && _outputMode == graphletFrequency), confident = false;
+    // Likewise with -s CC, each child uses one coloring, and is one batch of the error estimate
+    Boolean trackBatches = checkConfidence || _sampleMethod == SAMPLE_COLOR_CODING;
+    static double batchFrequency[MAX_POSSIBLE_THREADS][MAX_CANONICALS];
+    if(checkConfidence) meanSamplesPerJob = MIN(CONFIDENCE_BATCH, totalSamples);
+    if(_sampleMethod == SAMPLE_COLOR_CODING) meanSamplesPerJob = MIN(CC_SAMPLES_PER_COLORING, totalSamples);
     Warning("Parent %d starting about %d jobs of about %d samples each", getpid(), _JOBS, (int)meanSamplesPerJob);
+    if(_deadline || _sampleMethod == SAMPLE_EXACT) // the children add up how many samples they took, so we can report the total
+	_samplesTaken = SharedAlloc(sizeof(*_samplesTaken));
 
     int threadsRunning = 0, jobsDone = 0;
-    int thread, lineNum = 0, job=0;
+    int thread, lineNum = 0, job=0, canon;
     for(i=0; numSamples > 0 && i<_MAX_THREADS;i++) {
 	int samples = meanSamplesPerJob;
 	assert(samples>0);
@@ -595,6 +814,16 @@ int RunBlantInThreads(int k, int numSamples, GRAPH *G)
 		fpThreads[thread] = NULL;
 		++jobsDone; --threadsRunning;
 		Warning("Thead %d finished; jobsDone %d, threadsRunning %d", thread, jobsDone, threadsRunning);
+		if(trackBatches) {
+		    ConfidenceAddBatch(batchFrequency[thread]);
+		    for(canon=0; canon<_numCanon; canon++) batchFrequency[thread][canon] = 0;
+		    if(checkConfidence && !confident && (confident = ConfidenceReached())) {
+			Warning("all graphlet concentrations are within +/-%g (relative, 95%% confidence) after %d samples",
+			    confidence, totalSamples - numSamples);
+			numSamples = 0; // don't start any more jobs; the ones still running will be merged, too.
+		    }
+		}
+		if(DeadlinePassed()) numSamples = 0; // out of time; the other running jobs will stop on their own
 		if(numSamples == 0) fpThreads[thread] = NULL; // signify this pointer is finished.
 		else {
 		    int samples = meanSamplesPerJob;
@@ -610,15 +839,17 @@ int RunBlantInThreads(int k, int numSamples, GRAPH *G)
 	    }
 	    char *nextChar = line, *pch;
 	    unsigned long int count;
-	    int canon, orbit, numRead, nodeId, value;
+	    int orbit, numRead, nodeId, value;
 	    float fValue;
+	    double frequency;
 	    //fprintf(stderr, "Parent received the following line from the child: <%s>\n", line);
 	    switch(_outputMode)
 	    {
 	    case graphletFrequency:
-		numRead = sscanf(line, "%lu%d", &count, &canon);
-		assert(numRead == 2);
-		_graphletCount[canon] += count;
+		numRead = sscanf(line, "%lf%d", &frequency, &canon);
+		assert(numRead == 2 && 0 <= canon && canon < _numCanon);
+		_childFrequency[canon] += frequency;
+		if(trackBatches) batchFrequency[thread][canon] += frequency;
 		break;
 	    case graphletDistribution:
 		for(i=0; i<_numCanon; i++) {
@@ -631,49 +862,30 @@ int RunBlantInThreads(int k, int numSamples, GRAPH *G)
 		    assert(OK || (i==_numCanon-1 && j == _numCanon));
 		}
 		break;
-	    case outputGDV:
-		assert(isdigit(*nextChar));
-		numRead = sscanf(nextChar, "%d", &nodeId);
-		assert(numRead == 1 && nodeId == lineNum);
-		while(isdigit(*nextChar)) nextChar++; // read past current integer
-		assert(*nextChar == ' ' || (canon == _numCanon-1 && *nextChar == '\n'));
-		nextChar++;
-		for(canon=0; canon < _numCanon; canon++)
-		{
-		    assert(isdigit(*nextChar));
-		    numRead = sscanf(nextChar, "%lu", &count);
-		    assert(numRead == 1);
-		    GDV(lineNum,canon) += count;
-		    while(isdigit(*nextChar)) nextChar++; // read past current integer
-		    assert(*nextChar == ' ' || (canon == _numCanon-1 && *nextChar == '\n'));
-		    nextChar++;
-		}
-		assert(*nextChar == '\0');
-		break;
-	    case outputODV:
+	    case outputGDV: case outputODV:
 		assert(isdigit(*nextChar));
-		numRead = sscanf(nextChar, "%d", &nodeId);
-		assert(numRead == 1 && nodeId == lineNum);
-		while(isdigit(*nextChar)) nextChar++; // read past current integer
-		assert(*nextChar == ' ' || (orbit == _numOrbits-1 && *nextChar == '\n'));
-		nextChar++;
-		for(orbit=0; orbit < _numOrbits; orbit++)
+		nodeId = strtol(nextChar, &nextChar, 10);
+		assert(nodeId == lineNum);
+		// the child printed only its nonzero counts, as column:count, in the same columns as we'll print them
+		while(*nextChar == ' ')
 		{
-		    assert(isdigit(*nextChar));
-		    numRead = sscanf(nextChar, "%lu", &count);
-		    assert(numRead == 1);
-		    ODV(lineNum,orbit) += count;
-		    while(isdigit(*nextChar)) nextChar++; // read past current integer
-		    assert(*nextChar == ' ' || (orbit == _numOrbits-1 && *nextChar == '\n'));
-		    nextChar++;
+		    j = strtol(nextChar+1, &nextChar, 10);
+		    assert(*nextChar == ':');
+		    count = strtoul(nextChar+1, &nextChar, 10);
+		    if(_outputMode == outputGDV) ADD_GDV(lineNum,j,count);
+		    else {
+			if (k == 4 || k == 5) orbit = _connectedOrbits[_orca_orbit_mapping[j]];
+			else orbit = _connectedOrbits[j];
+			ADD_ODV(lineNum,orbit,count);
+		    }
 		}
-		assert(*nextChar == '\0');
+		assert(*nextChar == '\n' && nextChar[1] == '\0');
 		break;
 	    case indexGraphlets: case indexOrbits: case indexMotifs: case indexMotifOrbits:
-		fputs(line, stdout);
+		PutIndexLine(line);
 		if(_window)
 		    while(fgets(line, sizeof(line), fpThreads[thread]))
-			fputs(line, stdout);
+			PutIndexLine(line);
 		break;
 #if PREDICT
 	    case predict_merge: assert(false); break; // should not be here
@@ -690,8 +902,17 @@ int RunBlantInThreads(int k, int numSamples, GRAPH *G)
     } while(threadsRunning > 0);
 
     // if numSamples is not a multiple of _THREADS, finish the leftover samples
-    int leftovers = numSamples % _JOBS;
-    return RunBlantFromGraph(_k, leftovers, G);
+    int leftovers = checkConfidence ? 0 : numSamples % _JOBS;
+    if(checkConfidence && !confident) ConfidenceNotReachedWarning(totalSamples - numSamples);
+    else if(trackBatches && !checkConfidence) ColorCodingErrorWarning();
+    _childSamples = _samplesTaken ? *_samplesTaken : totalSamples - numSamples;
+    int status = RunBlantFromGraph(_k, leftovers, G);
+    if(_samplesTaken) {
+	if(_sampleMethod == SAMPLE_EXACT)
+	    Warning("-s EXACT: enumerated %ld %d-graphlets", *_samplesTaken, OrcaEquationsApply(k) ? k-1 : k);
+	else Warning("-T %g: took %ld samples in total", _timeBudget, *_samplesTaken);
+    }
+    return status;
 }
 
 void BlantAddEdge(int v1, int v2)
@@ -748,7 +969,8 @@ const char * const USAGE =
 "    K is an integer 3 through 8 inclusive, specifying the size (in nodes) of graphlets to sample;\n"\
 "    numSamples is the number of graphlet samples to take (large samples are recommended), except in INDEX sampling mode,\n"\
 "	where it specifies the maximum number of samples to take from each node in the graph.\n"\
-"	(note: -c {confidence} option is mutually exclusive to -n but is pending implementation)\n"\
+"	Alternatively, with -mf, use -c precision to keep sampling until the 95% confidence interval of every connected\n"\
+"	graphlet's concentration is within +/- precision (eg 0.01) times that concentration; -n then sets a maximum.\n"\
 "    samplingMethod is:\n"\
 "	NBE (node-based expansion): pick a node at random and add it to the node set S; add new nodes by choosing uniformly\n"\
 "           at random from all nodes one step outside S. (Fast on sparse networks, slightly biased counts)\n"\
@@ -758,13 +980,29 @@ const char * const USAGE =
 "           using an MCMC graph walking algorithm with restarts. (Asymptotically correct relative graphlet frequencies when\n"\
 "           using purely counting modes like -m{o|g|f}, but biased counts in indexing modes like -m{i|j} since we remove\n"\
 "           duplicates in indexing modes.)\n"\
-"	RES (Lu Bressan's reservoir sampling): also asymptotically correct but much slower than MCMC.\n"\
+"	RES (Lu Bressan's reservoir sampling): also asymptotically correct but much slower than MCMC. Once a node of degree\n"\
+"           at least 256 joins the sample, its frontier is drawn lazily from the neighbor lists instead of copied; RES{d}\n"\
+"           changes that degree to d (eg., RES1 is always lazy, RES1000000000 never).\n"\
+"	MHS (Lu Bressan's Metropolis-Hastings sampling): a random walk whose states are connected k-node sets, two being\n"\
+"           adjacent if they differ by one node; the Metropolis-Hastings rule makes every connected k-node set equally\n"\
+"           likely in the long run, so the counts are asymptotically correct without any of MCMC's overcount weights.\n"\
+"	OOZE: MHS with cheaper steps: replace a random node by a random neighbor of the others (O(k^2) rather than\n"\
+"           O(k*degree) per step), correcting for the non-uniform proposals in the acceptance test.\n"\
 "	AR (Accept-Reject): EXTREMELY SLOW but asymptotically correct: pick k nodes entirely at random, reject if\n"\
 "	    resulting graphlet is disconnected (vast majority of such grpahlets are disconnected, thus VERY SLOW)\n"\
 "	INDEX: unlike all other sampling methods that use randomness, this mode is deterministic: for each node v in the graph,\n"\
 "           build a topologically deterministic set of k-graphlets to be used as indices for seed-and-extend local\n"\
 "           alignments (using, eg., our onw Dijkstra-inspired local aligner--see Dijkstra diretory). When using INDEX sampling,\n"\
 "           the -n command-line option specifies the maximum number of index entries per starting node v.\n"\
+"	EXACT: not sampling at all: enumerate every connected induced k-graphlet exactly once (ESU algorithm), giving exact\n"\
+"           counts for -m{f|g|o}. -n is ignored. With -t, the jobs share out the nodes the enumeration starts from.\n"\
+"           With -mo and k<=5, only the (k-1)-graphlets are enumerated, and the orbit degrees are solved for from ORCA-style\n"\
+"           counting equations, which is typically one to two orders of magnitude faster.\n"\
+"	CC (color coding): color the nodes randomly with k colors, count the trees whose nodes all have different colors\n"\
+"           with dynamic programming, and sample such trees uniformly, weighting each graphlet by its number of spanning\n"\
+"           trees. Asymptotically correct concentrations for -mf, with far fewer samples than MCMC for rare (dense)\n"\
+"           graphlets at large k. Each coloring is used for 2^14 samples (with -t, one job per coloring), and the spread\n"\
+"           between colorings gives the error estimate reported at the end (and used by -c). Needs 2n*2^k doubles of RAM.\n"\
 "    graphInputFile: graph must be in one of the following formats with its extension name:\n"\
 "	Edgelist (.el), LEDA(.leda), GML (.gml), GraphML (.xml), LGF(.lgf), CSV(.csv)\n"\
 "	(extensions .gz and .xz are automatically decompressed using gunzip and unxz, respectively)\n"\
@@ -775,10 +1013,14 @@ const char * const USAGE =
 "	g = GDV (Graphlet Degree Vector) Note this is NOT what is commonly called a GDV, which is actually an ODV (above).\n"\
 "	NOTE: the difference is that an ODV counts the number of nodes that touch all possible *orbits*, while a GDV lists\n"\
 "		only the smaller vector of how many nodes touch each possible *graphlet* (independent of orbit).\n"\
+"	    sub-option -mo{vectorFormat} (also -mg{vectorFormat}) can be s(sparse): each line lists only the nonzero\n"\
+"	    counts, as column:count, numbering columns from 0 as in the full line; much smaller for large k.\n"\
 "	f = graphlet {f}requency, similar to Relative Graphlet Frequency, produces a raw count across our random samples.\n"\
 "	    sub-option -mf{freqDispMode} can be i(integer or count) or d(decimal or concentration)\n"\
 "	i = {i}ndex: each line is a graphlet with columns: canonical ID, then k nodes in canonical order; useful since\n"\
 "	    two lines with the same first column constitutes a PERFECT k-node local alignment between the two graphlets.\n"\
+"	    sub-option -mi{indexFormat} (also -mm{indexFormat}) can be b(binary records) or c(binary, column by column in\n"\
+"	    blocks), with the canonical IDs and node names in a header; blant-index2text converts either back to text.\n"\
 "	d = graphlet neighbor {D}istribution\n"\
 "    -d{displayMode} [no default--MANDATORY for indexing modes]: single character controls how canonical IDs are displayed:\n"\
 "	o = ORCA numbering\n"\
@@ -789,8 +1031,16 @@ const char * const USAGE =
 "Less Common OPTIONS:\n"\
 "    -t N[:M]: use threading (parallelism); break the task up into N jobs (default 1) allowing at most M to run at one time.\n"\
 "       M can be anything from 1 to a compile-time-specified maximum possible value (MAX_POSSIBLE_THREADS in blant.h),\n"\
-"       but defaults to 4 to be conservative.\n"\
+"       but defaults to 4 to be conservative. With -m{g|o}, up to M processes also format the final output in parallel.\n"\
 "    -r seed: pick your own random seed\n"\
+"    -x size: hybrid exact/sampled mode for -m{f|g|o}: enumerate every graphlet in the connected components with fewer\n"\
+"       than size nodes exactly (as in -s EXACT), and spend all samples on the larger components. The small components'\n"\
+"       counts get the weight sampling would have given them, so the output is in the same units, just less noisy.\n"\
+"    -T seconds: wall-clock time budget, counted from program start. All jobs sample as fast as they can until it's used\n"\
+"       up; frequencies are then normalized by the number of samples actually taken, which is reported on stderr (so you\n"\
+"       can normalize ODV/GDV counts). -n then sets a maximum. Leave some headroom for reading the graph and the output.\n"\
+"    -D megabytes: memory for the filter that drops node sets output recently in the index modes (-m{i|j|m|M}), per\n"\
+"       job (default 64); 0 turns it off. How many duplicates it caught is reported on stderr.\n"\
 "    -w windowSize: DEPRECATED. (use '-h' option for more)",
 * const USAGE2 = \
 "	-p windowRepSamplingMethod: (deprecated) one of the below\n"\
@@ -812,6 +1062,7 @@ int main(int argc, char *argv[])
     double windowRep_edge_density = 0.0;
     int exitStatus = 0;
 
+    _startTime = WallTime();
     if(argc == 1)
     {
 	printf("%s\n", USAGE);
@@ -823,7 +1074,7 @@ int main(int argc, char *argv[])
 
     _k = 0; _k_small = 0;
 
-    while((opt = getopt(argc, argv, "hm:d:t:r:s:c:k:K:e:g:w:p:P:l:n:M:A")) != -1)
+    while((opt = getopt(argc, argv, "hm:d:t:r:s:c:k:K:e:g:w:p:P:l:n:M:AT:x:D:")) != -1)
     {
 	switch(opt)
 	{
@@ -832,9 +1083,19 @@ int main(int argc, char *argv[])
 	    if(_outputMode != undef) Fatal("tried to define output mode twice");
 	    switch(*optarg)
 	    {
-	    case 'm': _outputMode = indexMotifs; break;
+	    case 'm': case 'i':
+		_outputMode = (*optarg == 'm') ? indexMotifs : indexGraphlets;
+		switch (*(optarg + 1))
+		{
+		    case 'b': _indexFormat = BLANT_INDEX_ROWS; break;
+		    case 'c': _indexFormat = BLANT_INDEX_COLUMNS; break;
+		    case '\0': break;
+		    default: Fatal("-m%c%c: unknown index format;\n"
+		    "\tformats are b=binary, c=binary by columns (or nothing for text)", *optarg, *(optarg + 1));
+		    break;
+		}
+	    break;
 	    case 'M': _outputMode = indexMotifOrbits; break;
-	    case 'i': _outputMode = indexGraphlets; break;
 	    case 'j': _outputMode = indexOrbits; break;
 	    case 'f': _outputMode = graphletFrequency;
 		switch (*(optarg + 1))
@@ -847,8 +1108,17 @@ int main(int argc, char *argv[])
 		    break;
 		}
 	    break;
-	    case 'g': _outputMode = outputGDV; break;
-	    case 'o': _outputMode = outputODV; break;
+	    case 'g': case 'o':
+		_outputMode = (*optarg == 'g') ? outputGDV : outputODV;
+		switch (*(optarg + 1))
+		{
+		    case 's': _sparseDegreeVectors = true; break;
+		    case '\0': break;
+		    default: Fatal("-m%c%c: unknown degree vector format;\n"
+		    "\tformats are s=sparse (or nothing for every count)", *optarg, *(optarg + 1));
+		    break;
+		}
+	    break;
 	    case 'd': _outputMode = graphletDistribution; break;
 #if PREDICT
 	    case 'p': _outputMode = predict; break;
@@ -891,19 +1161,30 @@ int main(int argc, char *argv[])
 		if (strchr(optarg, 'u') || strchr(optarg, 'U'))
 		    _MCMC_EVERY_EDGE=true;
 	    }
-	    else if (strncmp(optarg, "RES", 3) == 0)
+	    else if (strncmp(optarg, "RES", 3) == 0) {
 		_sampleMethod = SAMPLE_RESERVOIR;
+		if (optarg[3] && (sscanf(optarg+3, "%d", &_lazyFrontierHubDegree) != 1 || _lazyFrontierHubDegree < 1))
+		    Fatal("-s RES<degree>: the hub degree must be a positive integer, not '%s'", optarg+3);
+	    }
 	    else if (strncmp(optarg, "AR", 2) == 0)
 		_sampleMethod = SAMPLE_ACCEPT_REJECT;
 	    else if (strncmp(optarg, "INDEX", 5) == 0)
 		_sampleMethod = SAMPLE_INDEX;
+	    else if (strncmp(optarg, "EXACT", 5) == 0)
+		_sampleMethod = SAMPLE_EXACT;
+	    else if (strcmp(optarg, "CC") == 0)
+		_sampleMethod = SAMPLE_COLOR_CODING;
+	    else if (strcmp(optarg, "MHS") == 0)
+		_sampleMethod = SAMPLE_MHS;
+	    else if (strcmp(optarg, "OOZE") == 0)
+		_sampleMethod = SAMPLE_MHS_OOZE;
 	    else
 	    {
 		_sampleFileName = optarg;
 		if(strcmp(optarg,"STDIN") == 0) _sampleFile = stdin;
 		else _sampleFile = fopen(_sampleFileName, "r");
 		if(!_sampleFile)
-		    Fatal("Unrecognized sampling method specified: '%s'. Options are: {NBE|EBE|MCMC|RES|FAYE|AR|{filename}}\n"
+		    Fatal("Unrecognized sampling method specified: '%s'. Options are: {NBE|EBE|MCMC|RES|FAYE|AR|INDEX|EXACT|CC|MHS|OOZE|{filename}}\n"
 			"If unrecognized, we try opening a file by the name '%s', but no such file exists",
 			_sampleFileName, _sampleFileName);
 		_sampleMethod = SAMPLE_FROM_FILE;
@@ -911,7 +1192,6 @@ int main(int argc, char *argv[])
 	    break;
 	case 'c': confidence = atof(optarg);
         if (confidence < 0 || confidence > 1) Fatal("Confidence level must be between 0 and 1");
-	    // Apology("confidence intervals not implemented yet");
 	    break;
 	case 'k': _k = atoi(optarg);
 		if (_GRAPH_GEN && _k >= 33) {
@@ -989,6 +1269,15 @@ int main(int argc, char *argv[])
 	    break;
 	case 'A': _useAntidup = true;
 	    break;
+	case 'x': _exactComponentSize = atoi(optarg);
+	    if(_exactComponentSize < 0) Fatal("-x (exact component size) must be non-negative");
+	    break;
+	case 'D': _dedupMegabytes = atoi(optarg);
+	    if(_dedupMegabytes < 0) Fatal("-D (duplicate filter megabytes) must be non-negative");
+	    break;
+	case 'T': _timeBudget = atof(optarg);
+	    if(_timeBudget <= 0) Fatal("-T (time budget) must be a positive number of seconds");
+	    break;
 	    default: Fatal("unknown option %c\n%s", opt, USAGE);
 	}
     }
@@ -1004,8 +1293,39 @@ int main(int argc, char *argv[])
 	if (_freqDisplayMode == freq_display_mode_undef) // Default to integer(count)
 		_freqDisplayMode = count;
 
-    if(numSamples!=0 && confidence>0 && !_GRAPH_GEN)
-	Fatal("cannot specify both -n (sample size) and -c (confidence)");
+    if(_indexFormat && (_JOBS > 1 || _window))
+	Fatal("binary index output (-m{i|m}{b|c}) does not yet support -t or -w (feel free to add it!)");
+
+    if(_sampleMethod == SAMPLE_EXACT) {
+	if(_outputMode != graphletFrequency && _outputMode != outputGDV && _outputMode != outputODV)
+	    Fatal("-s EXACT currently supports only the counting output modes -mf, -mg, and -mo");
+	if(_window || confidence > 0 || _timeBudget > 0) Fatal("-s EXACT doesn't sample, so -w, -c, and -T make no sense");
+    }
+
+    if((_sampleMethod == SAMPLE_MHS || _sampleMethod == SAMPLE_MHS_OOZE) && _window)
+	Fatal("-s MHS and -s OOZE don't support windows (-w)");
+    if(_sampleMethod == SAMPLE_COLOR_CODING && (_outputMode != graphletFrequency || _window))
+	Fatal("-s CC currently supports only graphlet frequency output (-mf), without -w");
+
+    if(_exactComponentSize) {
+	if(_sampleMethod == SAMPLE_EXACT || _sampleMethod == SAMPLE_INDEX || _sampleMethod == SAMPLE_FROM_FILE ||
+	    _sampleMethod == SAMPLE_ACCEPT_REJECT || _sampleMethod == SAMPLE_COLOR_CODING || _MCMC_EVERY_EDGE)
+	    Fatal("-x needs a sampler that chooses a connected component first: NBE, EBE, FAYE, RES, MCMC, MHS, or OOZE");
+	if((_outputMode != graphletFrequency && _outputMode != outputGDV && _outputMode != outputODV) || _window)
+	    Fatal("-x currently supports only the counting output modes -mf, -mg, and -mo");
+    }
+
+    if(_timeBudget > 0) {
+	if(_sampleMethod == SAMPLE_INDEX) Fatal("-T (time budget) is not supported by the INDEX sampling method");
+	_deadline = _startTime + _timeBudget;
+	if(numSamples == 0) numSamples = TIME_BUDGET_MAX_SAMPLES;
+    }
+
+    if(confidence>0 && !_GRAPH_GEN) {
+	if(_outputMode != graphletFrequency || _window || _sampleMethod == SAMPLE_INDEX)
+	    Fatal("-c (confidence) is currently only supported for graphlet frequency output (-mf)");
+	if(numSamples == 0) numSamples = CONFIDENCE_MAX_SAMPLES;
+    }
 
     FILE *fpGraph;
     int piped = 0;
@@ -1,6 +1,7 @@
 #ifndef BLANT_H
 #define BLANT_H
 
+#include <limits.h>
 #include "tinygraph.h"
 #include "sets.h"
 #include "blant-window.h"
@@ -26,6 +27,13 @@ double RandomUniform(void) {
 
 #define GEN_SYN_GRAPH 0
 
+// Ask the CPU to start fetching the cache line at addr, which we expect to need shortly. A no-op if unsupported.
+#ifdef __GNUC__
+#define Prefetch(addr) __builtin_prefetch(addr)
+#else
+#define Prefetch(addr)
+#endif
+
 #define MAX_POSSIBLE_THREADS 64 // set this to something reasonable on your machine (eg odin.ics.uci.edu has 64 cores)
 extern int _JOBS, _MAX_THREADS;
 extern Boolean _earlyAbort;  // Can be set true by anybody anywhere, and they're responsible for producing a warning as to why
@@ -64,13 +72,82 @@ extern char* _BLANT_DIR;
 
 #define PARANOID_ASSERTS 1	// turn on copious assert checking --- slows down execution by a factor of 2-3
 
-extern unsigned long int *_graphletDegreeVector[MAX_CANONICALS];
-extern unsigned long int    *_orbitDegreeVector[MAX_ORBITS];
-extern double _g_overcount, *_doubleOrbitDegreeVector[MAX_ORBITS];
+// The ODV (or GDV) is a matrix of counts with a row per node and a column per connected orbit (or graphlet); only
+// connected ones can occur, so the others have no column, and read as zero. Rows are contiguous, since the output is
+// printed a row at a time, and so are the counts of nearby nodes. The counts start out 32 bits wide, and the whole
+// matrix is widened to 64 bits the first time one of them would overflow.
+// Increments from sampling (NodeCountsIncrement) are the bulk of the updates and land at random nodes, so they're
+// queued, and applied NODE_COUNTS_QUEUE at a time, sorted by block of 2^NODE_COUNTS_BLOCK_BITS counts, so that each
+// block is in cache while we apply its increments. Reading (or setting) a count applies the queue first.
+// With more than NODE_COUNTS_SPARSE_COLUMNS columns (k >= 7), most of a row is zeros, so each row is instead a small
+// hash table of its nonzero (64-bit) counts, which becomes a dense row once that would take less space.
+#define NODE_COUNTS_QUEUE (1 << 16) // 0 to apply increments immediately
+#define NODE_COUNTS_BLOCK_BITS 16 // 256kB of 32-bit counts
+#define NODE_COUNTS_SPARSE_COLUMNS 1024
+typedef struct _sparseRow {
+    unsigned size, used; unsigned char bits; // size = 2^bits slots, used of them full
+    unsigned *column; // column+1 in each slot, 0 if empty; NULL if the row is dense
+    unsigned long *count; // count[slot], or count[column] if the row is dense; NULL if the row is all zeros
+} SPARSE_ROW;
+typedef struct _nodeCounts {
+    int n, columns, *column; // column[orbit or graphlet], or -1 if it's disconnected
+    unsigned *narrow; unsigned long *wide; // n x columns, in the one that's not NULL
+    SPARSE_ROW *row; // instead, when sparse
+    unsigned long *queue; int queued; // increments not yet applied, as row*columns + column
+} NODE_COUNTS;
+void AllocNodeCounts(NODE_COUNTS *c, int n, int numIds, const int connected[], int numConnected);
+void WidenNodeCounts(NODE_COUNTS *c);
+void ApplyNodeCountsQueue(NODE_COUNTS *c);
+void NodeCountsRow(NODE_COUNTS *c, int v, unsigned long row[]); // all of v's counts, by column
+void FreeNodeCounts(NODE_COUNTS *c);
+unsigned long SparseRowGet(SPARSE_ROW *r, unsigned col);
+unsigned long *SparseRowSlot(SPARSE_ROW *r, unsigned col, int columns); // adds col if it's not there
+static inline unsigned long NodeCountsGet(NODE_COUNTS *c, int v, int id)
+{
+    if(c->queued) ApplyNodeCountsQueue(c);
+    if(c->column[id] < 0) return 0;
+    if(c->row) return SparseRowGet(c->row + v, c->column[id]);
+    unsigned long i = (unsigned long)v * c->columns + c->column[id];
+    return c->wide ? c->wide[i] : c->narrow[i];
+}
+static inline void NodeCountsSet(NODE_COUNTS *c, int v, int id, unsigned long x)
+{
+    if(c->queued) ApplyNodeCountsQueue(c);
+    if(c->column[id] < 0) { assert(x == 0); return; }
+    if(c->row) {
+	if(x || SparseRowGet(c->row + v, c->column[id])) *SparseRowSlot(c->row + v, c->column[id], c->columns) = x;
+	return;
+    }
+    unsigned long i = (unsigned long)v * c->columns + c->column[id];
+    if(!c->wide) {
+	if(x <= UINT_MAX) { c->narrow[i] = x; return; }
+	WidenNodeCounts(c);
+    }
+    c->wide[i] = x;
+}
+static inline void NodeCountsIncrement(NODE_COUNTS *c, int v, int id)
+{
+    assert(c->column[id] >= 0);
+#if NODE_COUNTS_QUEUE
+    c->queue[c->queued++] = (unsigned long)v * c->columns + c->column[id];
+    if(c->queued == NODE_COUNTS_QUEUE) ApplyNodeCountsQueue(c);
+#else
+    NodeCountsSet(c, v, id, NodeCountsGet(c, v, id) + 1);
+#endif
+}
+
+extern NODE_COUNTS _graphletDegreeVector, _orbitDegreeVector;
+extern double _g_overcount, *_doubleOrbitDegreeVector[MAX_ORBITS]; // instead of _orbitDegreeVector with -s MCMCu -mo
 
-// If you're squeemish then use this one to access the degrees:
-#define ODV(node,orbit)       _orbitDegreeVector[orbit][node]
-#define GDV(node,graphlet) _graphletDegreeVector[graphlet][node]
+// If you're squeemish then use these to access the degrees:
+#define ODV(node,orbit)       NodeCountsGet(&_orbitDegreeVector, node, orbit)
+#define GDV(node,graphlet) NodeCountsGet(&_graphletDegreeVector, node, graphlet)
+#define SET_ODV(node,orbit,x)       NodeCountsSet(&_orbitDegreeVector, node, orbit, x)
+#define SET_GDV(node,graphlet,x) NodeCountsSet(&_graphletDegreeVector, node, graphlet, x)
+#define ADD_ODV(node,orbit,x)       SET_ODV(node, orbit, ODV(node,orbit) + (x))
+#define ADD_GDV(node,graphlet,x) SET_GDV(node, graphlet, GDV(node,graphlet) + (x))
+#define INC_ODV(node,orbit)       NodeCountsIncrement(&_orbitDegreeVector, node, orbit)
+#define INC_GDV(node,graphlet) NodeCountsIncrement(&_graphletDegreeVector, node, graphlet)
 
 // Enable the code that uses C++ to parse input files?
 #define SHAWN_AND_ZICAN 0
@@ -111,7 +188,8 @@ extern int _numConnectedOrbits;
 extern int _numConnectedComponents;
 extern int *_componentSize; // number of nodes in each CC
 extern int *_whichComponent; // will be an array of size G->n specifying which CC each node is in.
-extern SET **_componentSet;
+extern int *_componentEdge; // indices into G->edgeList, grouped by CC (same order as the CCs themselves)
+extern int *_componentFirstEdge; // edges of CC c are _componentEdge[_componentFirstEdge[c] .. _componentFirstEdge[c+1]-1]
 
 extern double *_cumulativeProb;
 extern Boolean _child;